@@ -1,8 +1,12 @@
 #ifndef AST_H
 #define AST_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "DeclTable.h"
+#include "SymbolTable.h"
+#include <cstdint>
 
 // Forward Defines of classes used in the AST
 // class AST;
@@ -24,6 +28,7 @@ class Expression;
 class Term;
 class BinaryOp;
 class Final;
+class Assignment;
 
 // ASTVisitor class defines a visitor pattern to traverse the AST
 class ASTVisitor
@@ -41,40 +46,99 @@ public:
   virtual void visit(Expression &) = 0;
   virtual void visit(Term &) = 0;
   virtual void visit(IF &) = 0;
+  virtual void visit(Assignment &) = 0;
 };
 
 // AST class serves as the base class for all AST nodes
 class AST
 {
+public:
+  // Concrete node type, for switch-based dispatch (see RecursiveVisitor.h)
+  // and llvm::isa/dyn_cast
+  enum NodeKind : uint8_t
+  {
+    NK_Goal,
+    NK_Final,
+    NK_Condition,
+    NK_IF,
+    NK_BinaryOp,
+    NK_Loop,
+    NK_Expression,
+    NK_Term,
+    NK_Assignment,
+    NK_Define
+  };
+
+private:
+  uint32_t Loc = 0;                          // Source offset of the node, see LineTable
+  const NodeKind Kind;
+
+protected:
+  AST(NodeKind K) : Kind(K) {}
+
 public:
   virtual ~AST() {}
+  NodeKind getNodeKind() const { return Kind; }
   virtual void accept(ASTVisitor &V) = 0;    // Accept a visitor for traversal
+
+  uint32_t getLoc() { return Loc; }
+
+  void setLoc(uint32_t L) { Loc = L; }
 };
 
 // Expr class represents an expression in the AST
 class Expr : public AST
 {
 public:
-  Expr() {}
+  Expr(NodeKind K) : AST(K) {}
+};
+
+// Source extent of a top-level statement, [Begin, End) in input offsets.
+// Locations inside a statement reused by incremental reparsing are stale
+// by LocDelta, which diagnostics add back. Hash identifies the statement's
+// content once IncrementalSema has computed it (0 until then), and stays
+// with the statement when reparse() reuses it.
+struct StmtRange
+{
+  uint32_t Begin;
+  uint32_t End;
+  int32_t LocDelta;
+  uint64_t Hash;
 };
 
 // GSM class represents a group of expressions in the AST
 class Goal : public Expr
 {
   using ExprVector = llvm::SmallVector<Expr*>;
+  using RangeVector = llvm::SmallVector<StmtRange, 0>;
 
 private:
   ExprVector exprs;                          // Stores the list of expressions
+  RangeVector ranges;                        // One per expression, or empty
 
 public:
-  Goal(ExprVector exprs) : exprs(exprs) {}
+  Goal(ExprVector exprs, RangeVector ranges = RangeVector()) : Expr(NK_Goal), exprs(exprs), ranges(ranges) {}
 
   llvm::SmallVector<Expr *> getExprs() { return exprs; }
 
+  llvm::ArrayRef<StmtRange> getRanges() { return ranges; }
+
+  // LocDelta of the I-th statement (0 if ranges were not recorded)
+  int32_t getLocDelta(size_t I) { return I < ranges.size() ? ranges[I].LocDelta : 0; }
+
+  // content hash of the I-th statement (0 if not computed or not recorded)
+  uint64_t getHash(size_t I) { return I < ranges.size() ? ranges[I].Hash : 0; }
+  void setHash(size_t I, uint64_t Hash) {
+    if (I < ranges.size())
+      ranges[I].Hash = Hash;
+  }
+
   ExprVector::const_iterator begin() { return exprs.begin(); }
 
   ExprVector::const_iterator end() { return exprs.end(); }
 
+  static bool classof(const AST *N) { return N->getNodeKind() == NK_Goal; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -92,14 +156,25 @@ public:
   private:
   ValueKind Kind;                            // Stores the kind of Final (identifier or number)
   llvm::StringRef Val;                       // Stores the value of the Final
+  uint32_t Sym;                              // Interned ID of an identifier
+  uint32_t Decl = DeclTable::None;           // Declaration it resolves to, set by Sema
 
 public:
-  Final(ValueKind Kind, llvm::StringRef Val) : Kind(Kind), Val(Val) {}
+  Final(ValueKind Kind, llvm::StringRef Val, uint32_t Sym = SymbolTable::None)
+      : Expr(NK_Final), Kind(Kind), Val(Val), Sym(Sym) {}
 
   ValueKind getKind() { return Kind; }
 
   llvm::StringRef getVal() { return Val; }
 
+  uint32_t getSym() { return Sym; }
+
+  uint32_t getDecl() { return Decl; }
+
+  void setDecl(uint32_t D) { Decl = D; }
+
+  static bool classof(const AST *N) { return N->getNodeKind() == NK_Final; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -119,18 +194,22 @@ private:
     IFVector assignments;   // Stores the list of Assignments
 
 public:
-    Condition(llvm::SmallVector<Expr *> exprs, llvm::SmallVector<IF *> assignments) : exprs(exprs), assignments(assignments) {}
+    Condition(llvm::SmallVector<Expr *> exprs, llvm::SmallVector<IF *> assignments) : Expr(NK_Condition), exprs(exprs), assignments(assignments) {}
 
     ExprVector::const_iterator exprs_begin() { return exprs.begin(); }
 
     ExprVector::const_iterator exprs_end() { return exprs.end(); }
 
+    void setExpr(size_t I, Expr *E) { exprs[I] = E; }
+
     llvm::SmallVector<IF*> getAllAssignments() { return assignments; }
 
     IFVector::const_iterator assignments_begin() { return assignments.begin(); }
 
     IFVector::const_iterator assignments_end() { return assignments.end(); }
 
+    static bool classof(const AST *N) { return N->getNodeKind() == NK_Condition; }
+
     virtual void accept(ASTVisitor &V) override
     {
         V.visit(*this);
@@ -146,12 +225,14 @@ private:
     ExprVector assignments; // Stores the list of expressions
 
 public:
-   IF(llvm::SmallVector<Expr *> assignments) : assignments(assignments) {}
+   IF(llvm::SmallVector<Expr *> assignments) : Expr(NK_IF), assignments(assignments) {}
 
     ExprVector::const_iterator begin() { return assignments.begin(); }
 
     ExprVector::const_iterator end() { return assignments.end(); }
 
+    static bool classof(const AST *N) { return N->getNodeKind() == NK_IF; }
+
     virtual void accept(ASTVisitor &V) override
     {
         V.visit(*this);
@@ -192,7 +273,7 @@ private:
   Operator Op;                              // Operator of the binary operation
 
 public:
-  BinaryOp(Operator Op, Expr *L, Expr *R) : Op(Op), Left(L), Right(R) {}
+  BinaryOp(Operator Op, Expr *L, Expr *R) : Expr(NK_BinaryOp), Op(Op), Left(L), Right(R) {}
 
   Expr *getLeft() { return Left; }
 
@@ -200,6 +281,8 @@ public:
 
   Operator getOperator() { return Op; }
 
+  static bool classof(const AST *N) { return N->getNodeKind() == NK_BinaryOp; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -214,12 +297,16 @@ class Loop : public Expr
     IF *F;   
 
 public:
-    Loop(Expr *E, IF *F) : E(E), F(F) {}
+    Loop(Expr *E, IF *F) : Expr(NK_Loop), E(E), F(F) {}
 
     Expr *getExprs() { return E; }
 
+    void setExprs(Expr *Cond) { E = Cond; }
+
     IF *getIF() { return F; }
 
+    static bool classof(const AST *N) { return N->getNodeKind() == NK_Loop; }
+
     virtual void accept(ASTVisitor &V) override
     {
         V.visit(*this);
@@ -241,7 +328,7 @@ private:
   Operator Op;                              // Operator of the binary operation
 
 public:
-  Expression(Operator Op, Expr *L, Expr *R) : Op(Op), L(L), R(R) {}
+  Expression(Operator Op, Expr *L, Expr *R) : Expr(NK_Expression), Op(Op), L(L), R(R) {}
 
   Expr *getLeft() { return L; }
 
@@ -249,6 +336,8 @@ public:
 
   Operator getOperator() { return Op; }
 
+  static bool classof(const AST *N) { return N->getNodeKind() == NK_Expression; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -271,7 +360,7 @@ private:
   Operator Op;                              // Operator of the binary operation
 
 public:
-  Term(Operator Op, Expr *L, Expr *R) : Op(Op), Left(L), Right(R) {}
+  Term(Operator Op, Expr *L, Expr *R) : Expr(NK_Term), Op(Op), Left(L), Right(R) {}
 
   Expr *getLeft() { return Left; }
 
@@ -279,6 +368,8 @@ public:
 
   Operator getOperator() { return Op; }
 
+  static bool classof(const AST *N) { return N->getNodeKind() == NK_Term; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -292,12 +383,16 @@ private:
     Expr *Right;  // Right-hand side expression
 
 public:
-    Assignment(Final *L, Expr *R) : Left(L), Right(R) {}
+    Assignment(Final *L, Expr *R) : Expr(NK_Assignment), Left(L), Right(R) {}
 
     Final *getLeft() { return Left; }
 
     Expr *getRight() { return Right; }
 
+    void setRight(Expr *R) { Right = R; }
+
+    static bool classof(const AST *N) { return N->getNodeKind() == NK_Assignment; }
+
     virtual void accept(ASTVisitor &V) override
     {
         V.visit(*this);
@@ -308,22 +403,40 @@ public:
 class Define : public Expr
 {
   using VarVector = llvm::SmallVector<llvm::StringRef, 8>;
-  VarVector vars, exprs;
+  using SymVector = llvm::SmallVector<uint32_t, 8>;
+  using ExprVector = llvm::SmallVector<Expr *>;
+  VarVector vars;                            // Declared names
+  SymVector syms;                            // Interned IDs of the declared names
+  ExprVector exprs;                          // Initializers, may be fewer than vars
+  uint32_t firstDecl = DeclTable::None;      // Declaration of the first name, set by Sema
 
 public:
-  Define(llvm::SmallVector<llvm::StringRef, 8> Vars, VarVector ExprVector) : vars(vars), exprs(exprs) {}
+  Define(VarVector Vars, SymVector Syms, ExprVector Exprs) : Expr(NK_Define), vars(Vars), syms(Syms), exprs(Exprs) {}
 
-  llvm::SmallVector<llvm::StringRef, 8> getVars() { return vars; }
+  VarVector getVars() { return vars; }
 
-  llvm::SmallVector<llvm::StringRef, 8> getExprs() { return exprs; }
+  ExprVector getExprs() { return exprs; }
 
   VarVector::const_iterator begin() { return vars.begin(); }
 
   VarVector::const_iterator end() { return vars.end(); }
 
-  VarVector::const_iterator final_begin() { return exprs.begin(); }
-  
-  VarVector::const_iterator final_end() { return exprs.end(); }
+  SymVector::const_iterator sym_begin() { return syms.begin(); }
+
+  SymVector::const_iterator sym_end() { return syms.end(); }
+
+  ExprVector::const_iterator begin_values() { return exprs.begin(); }
+
+  ExprVector::const_iterator end_values() { return exprs.end(); }
+
+  void setValue(size_t I, Expr *E) { exprs[I] = E; }
+
+  // the names get consecutive declaration IDs starting here
+  uint32_t getFirstDecl() { return firstDecl; }
+
+  void setFirstDecl(uint32_t D) { firstDecl = D; }
+
+  static bool classof(const AST *N) { return N->getNodeKind() == NK_Define; }
 
   virtual void accept(ASTVisitor &V) override
   {
@@ -0,0 +1,320 @@
+#include "ASTCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <cstring>
+
+namespace
+{
+    const char Magic[8] = {'G', 'O', 'A', 'L', 'A', 'S', 'T', '\0'};
+
+    struct Header
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t NumNodes;
+        uint64_t SourceHash;
+        uint64_t SourceSize;
+        uint32_t NumExtra;
+        uint32_t NumSyms;
+        uint32_t NameBytes;
+        uint32_t Options;
+    };
+
+    uint64_t entrySize(const Header &H)
+    {
+        return sizeof(Header) + 4 * (3 * uint64_t(H.NumNodes) + H.NumExtra + H.NumSyms) +
+               2 * uint64_t(H.NumNodes) + H.NameBytes;
+    }
+
+    // Copies N elements from the mapped entry and advances Ptr.
+    template <typename T, typename VectorT>
+    void read(const char *&Ptr, uint32_t N, VectorT &Out)
+    {
+        Out.resize(N);
+        if (N)
+            std::memcpy(Out.data(), Ptr, N * sizeof(T));
+        Ptr += N * sizeof(T);
+    }
+
+    template <typename VectorT>
+    void write(llvm::raw_ostream &OS, const VectorT &V)
+    {
+        OS.write(reinterpret_cast<const char *>(V.data()), V.size() * sizeof(V[0]));
+    }
+
+    // Binary operators CodeGen lowers
+    bool isBinaryOperator(uint8_t Op)
+    {
+        switch (Op)
+        {
+        case BinaryOp::Plus:
+        case BinaryOp::Minus:
+        case BinaryOp::Mul:
+        case BinaryOp::Div:
+        case BinaryOp::power:
+        case BinaryOp::mod:
+        case BinaryOp::AND:
+        case BinaryOp::OR:
+        case BinaryOp::lte:
+        case BinaryOp::gte:
+        case BinaryOp::is_equal:
+        case BinaryOp::not_equal:
+        case BinaryOp::gt:
+        case BinaryOp::lt:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Sema and CodeGen index by operands unchecked and rely on the layout
+    // FlatAST(AST *) builds, so an entry must have it: every operand is a
+    // value node used by nothing else and computed right before its user
+    // (an expression is a contiguous range, see FlatAST::firstNode),
+    // statements take no values from outside, Defines are top-level with
+    // initializers only on leading names, and the markers nest.
+    bool isValid(const FlatAST &F, uint32_t NumSyms)
+    {
+        // where the innermost loopc or if chain is
+        enum State : uint8_t
+        {
+            LoopCond,   // before LoopTest
+            LoopBody,   // before LoopEnd
+            FirstTest,  // before the first CondTest
+            NextBranch, // after a BranchEnd: CondTest, CondElse or CondEnd
+            Branch,     // before a BranchEnd
+            ElseBranch, // before the BranchEnd of the else body
+            AfterElse   // before CondEnd
+        };
+        llvm::SmallVector<State, 16> Open;
+        llvm::SmallVector<uint32_t, 32> Pending; // values not used yet, last on top
+
+        auto use = [&](uint32_t Operand) {
+            if (Pending.empty() || Pending.back() != Operand)
+                return false;
+            Pending.pop_back();
+            return true;
+        };
+        // whether a statement may start here
+        auto inBody = [&]() {
+            return Pending.empty() &&
+                   (Open.empty() || Open.back() == LoopBody || Open.back() == Branch ||
+                    Open.back() == ElseBranch);
+        };
+
+        uint32_t N = uint32_t(F.size());
+        for (uint32_t I = 0; I < N; ++I)
+        {
+            uint32_t A = F.A[I], B = F.B[I];
+            switch (F.Kinds[I])
+            {
+            case FlatAST::Number:
+                break;
+            case FlatAST::Ident:
+                if (A >= NumSyms)
+                    return false;
+                break;
+            case FlatAST::Binary:
+                if (!isBinaryOperator(F.Ops[I]) || !use(B) || !use(A))
+                    return false;
+                break;
+            case FlatAST::Assign:
+                if (A >= NumSyms || !use(B) || !inBody())
+                    return false;
+                continue;
+            case FlatAST::Define:
+            {
+                if (!Open.empty() || uint64_t(A) + 2 * uint64_t(B) > F.Extra.size())
+                    return false;
+                uint32_t Inits = 0;
+                while (Inits < B && F.Extra[A + B + Inits] != FlatAST::None)
+                    ++Inits;
+                for (uint32_t J = 0; J < B; ++J)
+                    if (F.Extra[A + J] >= NumSyms || (J >= Inits && F.Extra[A + B + J] != FlatAST::None))
+                        return false;
+                while (Inits)
+                    if (!use(F.Extra[A + B + --Inits]))
+                        return false;
+                if (!Pending.empty())
+                    return false;
+                continue;
+            }
+            case FlatAST::LoopBegin:
+                if (!inBody())
+                    return false;
+                Open.push_back(LoopCond);
+                continue;
+            case FlatAST::LoopTest:
+                if (Open.empty() || Open.back() != LoopCond || !use(A) || !Pending.empty())
+                    return false;
+                Open.back() = LoopBody;
+                continue;
+            case FlatAST::LoopEnd:
+                if (Open.empty() || Open.back() != LoopBody || !Pending.empty())
+                    return false;
+                Open.pop_back();
+                continue;
+            case FlatAST::CondBegin:
+                if (!inBody())
+                    return false;
+                Open.push_back(FirstTest);
+                continue;
+            case FlatAST::CondTest:
+                if (Open.empty() || (Open.back() != FirstTest && Open.back() != NextBranch) ||
+                    !use(A) || !Pending.empty())
+                    return false;
+                Open.back() = Branch;
+                continue;
+            case FlatAST::CondElse:
+                if (Open.empty() || Open.back() != NextBranch || !Pending.empty())
+                    return false;
+                Open.back() = ElseBranch;
+                continue;
+            case FlatAST::BranchEnd:
+                if (Open.empty() || (Open.back() != Branch && Open.back() != ElseBranch) ||
+                    !Pending.empty())
+                    return false;
+                Open.back() = Open.back() == Branch ? NextBranch : AfterElse;
+                continue;
+            case FlatAST::CondEnd:
+                if (Open.empty() || (Open.back() != NextBranch && Open.back() != AfterElse) ||
+                    !Pending.empty())
+                    return false;
+                Open.pop_back();
+                continue;
+            default:
+                return false;
+            }
+            Pending.push_back(I); // a value node
+        }
+        return Open.empty() && Pending.empty();
+    }
+}
+
+ASTCache::ASTCache(llvm::StringRef Dir, llvm::StringRef Source, uint32_t Options)
+    : Hash(llvm::xxHash64(Source)), Size(Source.size()), Options(Options)
+{
+    llvm::SmallString<128> P(Dir);
+    llvm::SmallString<32> Name;
+    llvm::raw_svector_ostream(Name) << llvm::format_hex_no_prefix(Hash, 16) << "-" << Options
+                                    << ".gast";
+    llvm::sys::path::append(P, Name);
+    Path = std::string(P.str());
+}
+
+bool ASTCache::load(FlatAST &Flat, SymbolTable &Symbols) const
+{
+    llvm::Expected<llvm::sys::fs::file_t> FileOrErr = llvm::sys::fs::openNativeFileForRead(Path);
+    if (!FileOrErr)
+    {
+        llvm::consumeError(FileOrErr.takeError());
+        return false;
+    }
+    llvm::sys::fs::file_t File = *FileOrErr;
+
+    llvm::sys::fs::file_status Status;
+    std::error_code EC = llvm::sys::fs::status(File, Status);
+    if (EC || Status.getSize() < sizeof(Header))
+    {
+        llvm::sys::fs::closeFile(File);
+        return false;
+    }
+    llvm::sys::fs::mapped_file_region Map(File, llvm::sys::fs::mapped_file_region::readonly,
+                                          Status.getSize(), 0, EC);
+    llvm::sys::fs::closeFile(File);
+    if (EC)
+        return false;
+
+    const char *Ptr = Map.const_data();
+    Header H;
+    std::memcpy(&H, Ptr, sizeof(H));
+    if (std::memcmp(H.Magic, Magic, sizeof(Magic)) || H.Version != Version ||
+        H.SourceHash != Hash || H.SourceSize != Size || H.Options != Options ||
+        entrySize(H) != Map.size())
+        return false;
+    Ptr += sizeof(Header);
+
+    llvm::SmallVector<uint32_t, 0> Lengths;
+    read<uint32_t>(Ptr, H.NumNodes, Flat.A);
+    read<uint32_t>(Ptr, H.NumNodes, Flat.B);
+    read<uint32_t>(Ptr, H.NumNodes, Flat.Locs);
+    read<uint32_t>(Ptr, H.NumExtra, Flat.Extra);
+    read<uint32_t>(Ptr, H.NumSyms, Lengths);
+    read<FlatAST::Kind>(Ptr, H.NumNodes, Flat.Kinds);
+    read<uint8_t>(Ptr, H.NumNodes, Flat.Ops);
+
+    uint64_t Used = 0;
+    for (uint32_t Len : Lengths)
+        Used += Len;
+    if (Used != H.NameBytes || !isValid(Flat, H.NumSyms))
+    {
+        Flat = FlatAST();
+        return false;
+    }
+    for (uint32_t Len : Lengths)
+    {
+        Symbols.intern(llvm::StringRef(Ptr, Len));
+        Ptr += Len;
+    }
+    return true;
+}
+
+bool ASTCache::store(const FlatAST &Flat, const SymbolTable &Symbols) const
+{
+    Header H;
+    std::memcpy(H.Magic, Magic, sizeof(Magic));
+    H.Version = Version;
+    H.NumNodes = uint32_t(Flat.size());
+    H.SourceHash = Hash;
+    H.SourceSize = Size;
+    H.NumExtra = uint32_t(Flat.Extra.size());
+    H.NumSyms = uint32_t(Symbols.size());
+    H.NameBytes = 0;
+    H.Options = Options;
+
+    llvm::SmallVector<uint32_t, 0> Lengths;
+    for (uint32_t I = 0; I < H.NumSyms; ++I)
+    {
+        Lengths.push_back(uint32_t(Symbols.getName(I).size()));
+        H.NameBytes += Lengths.back();
+    }
+
+    int FD;
+    llvm::SmallString<128> TempPath;
+    std::error_code EC = llvm::sys::fs::create_directories(llvm::sys::path::parent_path(Path));
+    if (!EC)
+        EC = llvm::sys::fs::createUniqueFile(Path + "-%%%%%%.tmp", FD, TempPath);
+    if (EC)
+    {
+        llvm::errs() << "Error writing " << Path << ": " << EC.message() << "\n";
+        return false;
+    }
+    {
+        llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+        OS.write(reinterpret_cast<const char *>(&H), sizeof(H));
+        write(OS, Flat.A);
+        write(OS, Flat.B);
+        write(OS, Flat.Locs);
+        write(OS, Flat.Extra);
+        write(OS, Lengths);
+        write(OS, Flat.Kinds);
+        write(OS, Flat.Ops);
+        for (uint32_t I = 0; I < H.NumSyms; ++I)
+            OS << Symbols.getName(I);
+        OS.close();
+        EC = OS.error();
+    }
+    if (!EC)
+        EC = llvm::sys::fs::rename(TempPath, Path);
+    if (EC)
+    {
+        llvm::sys::fs::remove(TempPath);
+        llvm::errs() << "Error writing " << Path << ": " << EC.message() << "\n";
+        return false;
+    }
+    return true;
+}
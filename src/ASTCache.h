@@ -0,0 +1,53 @@
+#ifndef ASTCACHE_H
+#define ASTCACHE_H
+
+#include "FlatAST.h"
+#include "SymbolTable.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <string>
+
+// ASTCache keeps the FlatAST of a source file on disk so that an unchanged
+// input is not lexed and parsed again. Entries live in a cache directory,
+// one file per source and set of options that shape the tree, named after
+// a hash of the source contents and those options:
+//
+//   header      magic, format version, source hash and size, array sizes,
+//               options
+//   uint32_t[]  A, B, Locs (one per node), Extra, name lengths
+//   uint8_t[]   Kinds, Ops (one per node), then the identifier names
+//
+// Symbols are stored in ID order, so interning them into an empty table
+// reproduces the IDs the nodes refer to. Entries are mmap'ed on load and
+// written through a temporary file, so readers never see a partial entry.
+class ASTCache
+{
+    std::string Path;   // entry for the current source
+    uint64_t Hash;      // of the source contents
+    uint64_t Size;      // of the source, in bytes
+    uint32_t Options;   // Option bits the stored tree was built with
+
+public:
+    // Bump whenever the layout or the meaning of FlatAST nodes changes
+    static const uint32_t Version = 2;
+
+    // Options that change the tree stored for a source
+    enum Option : uint32_t
+    {
+        FoldedConstants = 1 // constants were folded before flattening
+    };
+
+    ASTCache(llvm::StringRef Dir, llvm::StringRef Source, uint32_t Options = 0);
+
+    const std::string &getPath() const { return Path; }
+
+    // Fills Flat and Symbols (which must be empty) from the entry; returns
+    // false if there is none, it does not match the source, or its tree is
+    // not one FlatAST(AST *) could have built.
+    bool load(FlatAST &Flat, SymbolTable &Symbols) const;
+
+    // Writes the entry; returns false and prints the reason on failure.
+    bool store(const FlatAST &Flat, const SymbolTable &Symbols) const;
+};
+
+#endif
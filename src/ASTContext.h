@@ -0,0 +1,159 @@
+#ifndef ASTCONTEXT_H
+#define ASTCONTEXT_H
+
+#include "AST.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Allocator.h"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Nodes whose SmallVector members may spill to the heap need their
+// destructor run before the arena is released; the others are dropped
+// with the arena without running any code.
+template <typename T> struct ASTNodeOwnsStorage : std::true_type {};
+template <> struct ASTNodeOwnsStorage<Final> : std::false_type {};
+template <> struct ASTNodeOwnsStorage<BinaryOp> : std::false_type {};
+template <> struct ASTNodeOwnsStorage<Expression> : std::false_type {};
+template <> struct ASTNodeOwnsStorage<Term> : std::false_type {};
+template <> struct ASTNodeOwnsStorage<Assignment> : std::false_type {};
+template <> struct ASTNodeOwnsStorage<Loop> : std::false_type {};
+
+// ASTContext owns every node of one tree. Nodes are bump-allocated from a
+// single arena and all freed together when the context is destroyed,
+// which must happen after the last phase (CodeGen) is done with the tree.
+class ASTContext
+{
+    llvm::BumpPtrAllocator Alloc;
+    std::vector<AST *> NeedsDestroy;
+    std::vector<std::unique_ptr<ASTContext>> Children;
+    size_t NumNodes = 0;
+
+    // node kind and operator, then two operands identifying a pure expression
+    using ExprKey = std::tuple<unsigned, uint64_t, uint64_t>;
+    llvm::DenseMap<ExprKey, Expr *> SharedExprs;
+    bool ShareExprs = false;
+    size_t NumShared = 0;
+
+    template <typename T, typename... Args>
+    T *getShared(const ExprKey &Key, uint32_t Loc, Args &&...args)
+    {
+        Expr *&Slot = SharedExprs[Key];
+        if (Slot)
+        {
+            ++NumShared;
+            return static_cast<T *>(Slot);
+        }
+        T *Node = create<T>(std::forward<Args>(args)...);
+        Node->setLoc(Loc);
+        Slot = Node;
+        return Node;
+    }
+
+public:
+    ASTContext() = default;
+    ASTContext(const ASTContext &) = delete;
+    ASTContext &operator=(const ASTContext &) = delete;
+
+    ~ASTContext()
+    {
+        for (auto I = NeedsDestroy.rbegin(), E = NeedsDestroy.rend(); I != E; ++I)
+            (*I)->~AST();
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args)
+    {
+        T *Node = new (Alloc.Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (ASTNodeOwnsStorage<T>::value)
+            NeedsDestroy.push_back(Node);
+        ++NumNodes;
+        return Node;
+    }
+
+    // Hash-consing: while enabled, getFinal and getBinaryOp return the
+    // existing node for a structurally identical expression instead of
+    // building a new one, so equal subexpressions are equal pointers. A
+    // shared node keeps the location of its first occurrence.
+    void setShareExprs(bool Enable) { ShareExprs = Enable; }
+
+    Final *getFinal(Final::ValueKind Kind, llvm::StringRef Val, uint32_t Sym, uint32_t Loc)
+    {
+        unsigned Tag = (unsigned(AST::NK_Final) << 8) | Kind;
+        uint64_t Value;
+        // identifiers need an interned symbol; numbers too large to key on are not shared
+        if (ShareExprs && Kind == Final::Id && Sym != SymbolTable::None)
+            return getShared<Final>(ExprKey(Tag, Sym, 0), Loc, Kind, Val, Sym);
+        if (ShareExprs && Kind == Final::Number && !Val.getAsInteger(10, Value))
+            return getShared<Final>(ExprKey(Tag, Value, 0), Loc, Kind, Val, Sym);
+        Final *Node = create<Final>(Kind, Val, Sym);
+        Node->setLoc(Loc);
+        return Node;
+    }
+
+    // a literal of Value that is not in the source, e.g. a folded constant;
+    // its text is kept in the arena
+    Final *getNumber(int32_t Value, uint32_t Loc)
+    {
+        std::string Digits = llvm::itostr(Value);
+        char *Text = static_cast<char *>(Alloc.Allocate(Digits.size(), 1));
+        std::memcpy(Text, Digits.data(), Digits.size());
+        return getFinal(Final::Number, llvm::StringRef(Text, Digits.size()), SymbolTable::None, Loc);
+    }
+
+    BinaryOp *getBinaryOp(BinaryOp::Operator Op, Expr *L, Expr *R, uint32_t Loc)
+    {
+        if (ShareExprs)
+            return getShared<BinaryOp>(ExprKey((unsigned(AST::NK_BinaryOp) << 8) | Op,
+                                               reinterpret_cast<uintptr_t>(L),
+                                               reinterpret_cast<uintptr_t>(R)),
+                                       Loc, Op, L, R);
+        BinaryOp *Node = create<BinaryOp>(Op, L, R);
+        Node->setLoc(Loc);
+        return Node;
+    }
+
+    // a separate arena freed together with this one, e.g. for a worker
+    // thread; creating children is not thread-safe, using them is.
+    // Children share expressions like their parent, but only among their
+    // own nodes.
+    ASTContext &createChild()
+    {
+        Children.push_back(std::make_unique<ASTContext>());
+        Children.back()->setShareExprs(ShareExprs);
+        return *Children.back();
+    }
+
+    size_t getNumNodes() const
+    {
+        size_t N = NumNodes;
+        for (const auto &C : Children)
+            N += C->getNumNodes();
+        return N;
+    }
+
+    // requests answered with an existing node by hash-consing
+    size_t getNumShared() const
+    {
+        size_t N = NumShared;
+        for (const auto &C : Children)
+            N += C->getNumShared();
+        return N;
+    }
+
+    // bytes reserved by the arenas, i.e. their peak footprint
+    size_t getMemoryUsed() const
+    {
+        size_t N = Alloc.getTotalMemory();
+        for (const auto &C : Children)
+            N += C->getMemoryUsed();
+        return N;
+    }
+};
+
+#endif
@@ -0,0 +1,553 @@
+#include "CodeGen.h"
+#include "ConstantFold.h"
+#include "IncrementalParser.h"
+#include "LLParser.h"
+#include "Parser.h"
+#include "ProgramGenerator.h"
+#include "RecursiveVisitor.h"
+#include "Sema.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <string>
+
+// goal_bench times each front-end phase on a fixed corpus and reports
+// throughput together with the heap allocations the phase performed and
+// the most heap memory it held at once.
+
+// Count every heap allocation made by the program. Each block carries its
+// size in front, so that the bytes in use and their high-water mark can be
+// kept as well. llvm::SmallVector grows with malloc and is not counted,
+// which leaves out the arrays of FlatAST; "flat:" prints their size.
+static std::atomic<uint64_t> NumAllocs(0);
+static std::atomic<uint64_t> AllocBytes(0);
+static std::atomic<uint64_t> LiveBytes(0);
+static std::atomic<uint64_t> PeakBytes(0);
+
+static const size_t HeaderSize = alignof(std::max_align_t);
+
+void *operator new(size_t Size)
+{
+    NumAllocs.fetch_add(1, std::memory_order_relaxed);
+    AllocBytes.fetch_add(Size, std::memory_order_relaxed);
+    uint64_t Live = LiveBytes.fetch_add(Size, std::memory_order_relaxed) + Size;
+    uint64_t Peak = PeakBytes.load(std::memory_order_relaxed);
+    while (Live > Peak && !PeakBytes.compare_exchange_weak(Peak, Live, std::memory_order_relaxed))
+        ;
+    if (char *P = static_cast<char *>(std::malloc(HeaderSize + Size)))
+    {
+        *reinterpret_cast<size_t *>(P) = Size;
+        return P + HeaderSize;
+    }
+    std::abort();
+}
+
+void operator delete(void *P) noexcept
+{
+    if (!P)
+        return;
+    char *Block = static_cast<char *>(P) - HeaderSize;
+    LiveBytes.fetch_sub(*reinterpret_cast<size_t *>(Block), std::memory_order_relaxed);
+    std::free(Block);
+}
+
+void operator delete(void *P, size_t) noexcept { operator delete(P); }
+
+// Optional input file; the built-in corpus is used when it is empty.
+static llvm::cl::opt<std::string>
+    InputFilename(llvm::cl::Positional,
+                  llvm::cl::desc("[input file]"),
+                  llvm::cl::init(""));
+
+// Size of the built-in corpus, made by the goal_gen generator.
+static llvm::cl::opt<unsigned>
+    Statements("statements",
+               llvm::cl::desc("Statements in the built-in corpus"),
+               llvm::cl::init(100000));
+
+// Size of the corpus the threaded Sema is also timed on when the main one
+// is too small to be split into every range.
+static llvm::cl::opt<unsigned>
+    ParallelStatements("parallel-statements",
+                       llvm::cl::desc("Statements in the corpus for threaded Sema "
+                                      "when the main one is too small"),
+                       llvm::cl::init(100000));
+
+// Each phase is run this many times and the fastest run is reported.
+static llvm::cl::opt<unsigned>
+    Iterations("iterations",
+               llvm::cl::desc("Runs per phase, the fastest is reported"),
+               llvm::cl::init(5));
+
+namespace
+{
+    // Counts the nodes reachable through the visitor interface.
+    class NodeCounter : public ASTVisitor
+    {
+    public:
+        uint64_t Count = 0;
+
+        virtual void visit(Expr &) override { ++Count; }
+        virtual void visit(Goal &Node) override
+        {
+            ++Count;
+            for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
+                if (*I)
+                    (*I)->accept(*this);
+        }
+        virtual void visit(BinaryOp &Node) override
+        {
+            ++Count;
+            Node.getLeft()->accept(*this);
+            Node.getRight()->accept(*this);
+        }
+        virtual void visit(Define &Node) override
+        {
+            ++Count;
+            for (auto I = Node.begin_values(), E = Node.end_values(); I != E; ++I)
+                (*I)->accept(*this);
+        }
+        virtual void visit(Final &) override { ++Count; }
+        virtual void visit(Loop &) override { ++Count; }
+        virtual void visit(Condition &) override { ++Count; }
+        virtual void visit(Expression &) override { ++Count; }
+        virtual void visit(Term &) override { ++Count; }
+        virtual void visit(IF &) override { ++Count; }
+        virtual void visit(Assignment &Node) override
+        {
+            ++Count;
+            Node.getRight()->accept(*this);
+        }
+    };
+
+    // The same full traversal through both dispatch mechanisms, to compare
+    // virtual double dispatch with the kind switch of RecursiveVisitor.
+    class VirtualWalker : public ASTVisitor
+    {
+    public:
+        uint64_t Count = 0;
+
+        virtual void visit(Goal &Node) override
+        {
+            ++Count;
+            for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
+                (*I)->accept(*this);
+        }
+        virtual void visit(Final &) override { ++Count; }
+        virtual void visit(Condition &Node) override
+        {
+            ++Count;
+            for (auto I = Node.exprs_begin(), E = Node.exprs_end(); I != E; ++I)
+                (*I)->accept(*this);
+            for (auto I = Node.assignments_begin(), E = Node.assignments_end(); I != E; ++I)
+                (*I)->accept(*this);
+        }
+        virtual void visit(IF &Node) override
+        {
+            ++Count;
+            for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
+                (*I)->accept(*this);
+        }
+        virtual void visit(BinaryOp &Node) override
+        {
+            ++Count;
+            Node.getLeft()->accept(*this);
+            Node.getRight()->accept(*this);
+        }
+        virtual void visit(Loop &Node) override
+        {
+            ++Count;
+            Node.getExprs()->accept(*this);
+            Node.getIF()->accept(*this);
+        }
+        virtual void visit(Expression &Node) override
+        {
+            ++Count;
+            Node.getLeft()->accept(*this);
+            Node.getRight()->accept(*this);
+        }
+        virtual void visit(Term &Node) override
+        {
+            ++Count;
+            Node.getLeft()->accept(*this);
+            Node.getRight()->accept(*this);
+        }
+        virtual void visit(Assignment &Node) override
+        {
+            ++Count;
+            Node.getLeft()->accept(*this);
+            Node.getRight()->accept(*this);
+        }
+        virtual void visit(Define &Node) override
+        {
+            ++Count;
+            for (auto I = Node.begin_values(), E = Node.end_values(); I != E; ++I)
+                (*I)->accept(*this);
+        }
+    };
+
+    class StaticWalker : public RecursiveVisitor<StaticWalker>
+    {
+        using Base = RecursiveVisitor<StaticWalker>;
+
+    public:
+        uint64_t Count = 0;
+
+        template <typename NodeT>
+        void visit(NodeT &Node)
+        {
+            ++Count;
+            Base::visit(Node);
+        }
+    };
+
+    struct Measurement
+    {
+        double Seconds;
+        uint64_t Allocs;
+        uint64_t Bytes;
+        uint64_t Peak; // most bytes in use at once, above those at the start
+    };
+
+    // Runs Phase Runs times and keeps the fastest run.
+    template <typename Fn>
+    Measurement measure(Fn Phase, unsigned Runs = Iterations)
+    {
+        Measurement Best = {1e300, 0, 0, 0};
+        for (unsigned I = 0; I < Runs; ++I)
+        {
+            uint64_t Allocs = NumAllocs.load(), Bytes = AllocBytes.load();
+            uint64_t Live = LiveBytes.load();
+            PeakBytes.store(Live);
+            auto Start = std::chrono::steady_clock::now();
+            Phase();
+            auto Stop = std::chrono::steady_clock::now();
+            double Secs = std::chrono::duration<double>(Stop - Start).count();
+            if (Secs < Best.Seconds)
+                Best = {Secs, NumAllocs.load() - Allocs, AllocBytes.load() - Bytes,
+                        PeakBytes.load() - Live};
+        }
+        return Best;
+    }
+
+    void report(const char *Phase, const Measurement &M, uint64_t Items, const char *Unit)
+    {
+        llvm::outs() << llvm::format("%-14s %10.3f ms %14.0f %s/s %10llu allocs %12llu bytes"
+                                     " %12llu peak\n",
+                                     Phase, M.Seconds * 1e3, Items / M.Seconds, Unit,
+                                     (unsigned long long)M.Allocs,
+                                     (unsigned long long)M.Bytes,
+                                     (unsigned long long)M.Peak);
+    }
+}
+
+// The main function of the benchmark.
+int main(int argc, const char **argv)
+{
+    llvm::InitLLVM X(argc, argv);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "goal_bench - front-end benchmarks\n");
+
+    // Load the corpus, NUL terminated as the Lexer expects.
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+    if (InputFilename.empty())
+    {
+        GeneratorOptions Opts;
+        Opts.Statements = Statements;
+        std::string Corpus;
+        llvm::raw_string_ostream OS(Corpus);
+        generateProgram(Opts, OS);
+        Buffer = llvm::MemoryBuffer::getMemBufferCopy(OS.str(), "corpus");
+    }
+    else
+    {
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileOrErr =
+            llvm::MemoryBuffer::getFile(InputFilename);
+        if (std::error_code EC = FileOrErr.getError())
+        {
+            llvm::errs() << "Error reading " << InputFilename << ": "
+                         << EC.message() << "\n";
+            return 1;
+        }
+        Buffer = std::move(*FileOrErr);
+    }
+    llvm::StringRef Src = Buffer->getBuffer();
+    llvm::outs() << "corpus: " << Src.size() << " bytes\n";
+
+    // Lexer::next on its own.
+    uint64_t Tokens = 0;
+    Measurement Lex = measure([&]
+    {
+        SymbolTable Symbols;
+        Lexer L(Src, &Symbols);
+        Token Tok;
+        Tokens = 0;
+        do
+        {
+            L.next(Tok);
+            ++Tokens;
+        } while (!Tok.is(Token::eoi));
+    });
+    report("lex", Lex, Tokens, "tokens");
+
+    // Parser::parse including the lexing it pulls.
+    uint64_t Nodes = 0;
+    Measurement Parse = measure([&]
+    {
+        SymbolTable Symbols;
+        Lexer L(Src, &Symbols);
+        ASTContext Context;
+        Parser P(L, Context);
+        AST *Tree = P.parse();
+        NodeCounter Counter;
+        if (Tree)
+            Tree->accept(Counter);
+        Nodes = Counter.Count;
+    });
+    report("parse", Parse, Nodes, "nodes");
+
+    // LLParser::parse, the table-driven parser generated from Grammar.txt.
+    // It is slower than Parser, not faster: on the default corpus it took
+    // 637-716 ms against 593-639 ms, 5-20% behind over three runs.
+    Measurement ParseLL = measure([&]
+    {
+        SymbolTable Symbols;
+        Lexer L(Src, &Symbols);
+        ASTContext Context;
+        LLParser P(L, Context);
+        AST *Tree = P.parse();
+        NodeCounter Counter;
+        if (Tree)
+            Tree->accept(Counter);
+        Nodes = Counter.Count;
+    });
+    report("parse ll", ParseLL, Nodes, "nodes");
+
+    // Sema and CodeGen run on one tree, built once.
+    SymbolTable Symbols;
+    Lexer L(Src, &Symbols);
+    ASTContext Context;
+    Parser P(L, Context);
+    AST *Tree = P.parse();
+    llvm::outs() << "arena: " << Context.getNumNodes() << " nodes in "
+                 << Context.getMemoryUsed() << " bytes\n";
+    {
+        SymbolTable SharedSymbols;
+        Lexer SharedLex(Src, &SharedSymbols);
+        ASTContext Shared;
+        Shared.setShareExprs(true);
+        Parser SharedParser(SharedLex, Shared);
+        SharedParser.parse();
+        llvm::outs() << "shared arena: " << Shared.getNumNodes() << " nodes in "
+                     << Shared.getMemoryUsed() << " bytes, "
+                     << Shared.getNumShared() << " reused\n";
+        uint64_t Requests = Shared.getNumNodes() + Shared.getNumShared();
+        llvm::outs() << llvm::format("sharing: %.1f%% of %llu nodes reused, %.1f%% of the arena bytes\n",
+                                     100.0 * Shared.getNumShared() / Requests,
+                                     (unsigned long long)Requests,
+                                     100.0 * Shared.getMemoryUsed() / Context.getMemoryUsed());
+    }
+    if (!Tree || P.hasError())
+    {
+        llvm::errs() << "Syntax errors occurred\n";
+        return 1;
+    }
+
+    uint64_t Walked = 0;
+    Measurement Virtual = measure([&]
+    {
+        VirtualWalker W;
+        Tree->accept(W);
+        Walked = W.Count;
+    });
+    report("walk virtual", Virtual, Walked, "nodes");
+
+    Measurement Static = measure([&]
+    {
+        StaticWalker W;
+        W.dispatch(Tree);
+        Walked = W.Count;
+    });
+    report("walk static", Static, Walked, "nodes");
+    llvm::outs() << llvm::format("dispatch: virtual %.2f ns/node, static %.2f ns/node\n",
+                                 Virtual.Seconds * 1e9 / Walked, Static.Seconds * 1e9 / Walked);
+
+    Measurement Semantic = measure([&]
+    {
+        Sema S;
+        S.semantic(Tree);
+    });
+    report("sema", Semantic, Nodes, "nodes");
+
+    // The same check split across a thread pool, for its scaling. Sema
+    // does not split a program too small for the ranges it wants, and
+    // that serial check is not reported again under a thread count.
+    const unsigned ThreadCounts[] = {2, 4, 8};
+    auto timeThreads = [&](const std::string &Name, AST *Program, uint64_t Count)
+    {
+        auto *Stmts = llvm::cast<Goal>(Program);
+        size_t NumStmts = Stmts->end() - Stmts->begin();
+        for (unsigned Threads : ThreadCounts)
+        {
+            std::string Phase = Name + " x" + std::to_string(Threads);
+            size_t Ranges = Sema::getNumRanges(NumStmts, Threads);
+            if (Ranges <= 1)
+            {
+                llvm::outs() << Phase << ": not split, " << NumStmts << " statements\n";
+                continue;
+            }
+            Measurement ParallelSemantic = measure([&]
+            {
+                Sema S;
+                S.semantic(Program, nullptr, Threads);
+            });
+            report(Phase.c_str(), ParallelSemantic, Count, "nodes");
+            llvm::outs() << Phase << ": " << Ranges << " ranges\n";
+        }
+    };
+    timeThreads("sema", Tree, Nodes);
+
+    // When the corpus is too small for every range at the most threads,
+    // the scaling is measured on a generated one large enough as well.
+    {
+        auto *Stmts = llvm::cast<Goal>(Tree);
+        unsigned MaxThreads = *std::max_element(std::begin(ThreadCounts), std::end(ThreadCounts));
+        if (Sema::getNumRanges(Stmts->end() - Stmts->begin(), MaxThreads) <
+                Sema::getNumRanges(ParallelStatements, MaxThreads))
+        {
+            GeneratorOptions Opts;
+            Opts.Statements = ParallelStatements;
+            std::string Large;
+            llvm::raw_string_ostream OS(Large);
+            generateProgram(Opts, OS);
+            OS.flush();
+            SymbolTable LargeSymbols;
+            Lexer LargeLex(Large, &LargeSymbols);
+            ASTContext LargeContext;
+            Parser LargeParser(LargeLex, LargeContext);
+            AST *LargeTree = LargeParser.parse();
+            if (LargeTree && !LargeParser.hasError())
+            {
+                NodeCounter Counter;
+                LargeTree->accept(Counter);
+                Measurement LargeSemantic = measure([&]
+                {
+                    Sema S;
+                    S.semantic(LargeTree);
+                });
+                report("sema large", LargeSemantic, Counter.Count, "nodes");
+                timeThreads("sema large", LargeTree, Counter.Count);
+            }
+        }
+    }
+
+    // IncrementalSema after a one-digit edit in the middle statement,
+    // switching between the two versions so every run has one to recheck.
+    auto *Program = llvm::cast<Goal>(Tree);
+    llvm::ArrayRef<StmtRange> Ranges = Program->getRanges();
+    const StmtRange &Middle = Ranges[Ranges.size() / 2];
+    size_t Digit = Src.find_first_of("0123456789", Middle.Begin);
+    if (Digit < Middle.End)
+    {
+        std::string Edited = Src.str();
+        Edited[Digit] = Edited[Digit] == '1' ? '2' : '1';
+        bool HasError;
+        Goal *Versions[] = {Program, reparse(*Program, {uint32_t(Digit), 1, 1}, Edited,
+                                             Context, Symbols, nullptr, HasError)};
+        IncrementalSema Incremental;
+        Incremental.semantic(*Program);
+        unsigned Version = 0, Checked = 0;
+        Measurement Recheck = measure([&]
+        {
+            Version ^= 1;
+            Incremental.semantic(*Versions[Version]);
+            Checked = Incremental.getNumChecked();
+        });
+        report("sema edit", Recheck, Ranges.size(), "stmts");
+        llvm::outs() << "sema edit: " << Checked << " of " << Ranges.size()
+                     << " statements checked\n";
+    }
+
+    Measurement Gen = measure([&]
+    {
+        CodeGen CG;
+        CG.compile(Tree, llvm::nulls());
+    });
+    report("codegen", Gen, Nodes, "nodes");
+
+    // CodeGen of a shared tree computes a repeated subexpression once per
+    // basic block.
+    {
+        SymbolTable SharedSymbols;
+        Lexer SharedLex(Src, &SharedSymbols);
+        ASTContext Shared;
+        Shared.setShareExprs(true);
+        Parser SharedParser(SharedLex, Shared);
+        AST *SharedTree = SharedParser.parse();
+        if (SharedTree && !SharedParser.hasError() && !Sema().semantic(SharedTree))
+        {
+            Measurement SharedGen = measure([&]
+            {
+                CodeGen CG;
+                CG.compile(SharedTree, llvm::nulls());
+            });
+            report("shared codegen", SharedGen, Nodes, "nodes");
+        }
+    }
+
+    // The same passes over the flat encoding.
+    uint64_t FlatNodes = 0;
+    Measurement Flatten = measure([&]
+    {
+        FlatAST F(Tree);
+        FlatNodes = F.size();
+    });
+    report("flatten", Flatten, FlatNodes, "nodes");
+
+    FlatAST Flat(Tree);
+    llvm::outs() << "flat: " << Flat.size() << " nodes in "
+                 << Flat.size() * (sizeof(FlatAST::Kind) + sizeof(uint8_t) + 3 * sizeof(uint32_t)) +
+                        Flat.Extra.size() * sizeof(uint32_t)
+                 << " bytes\n";
+
+    Measurement FlatSemantic = measure([&]
+    {
+        Sema S;
+        S.semantic(Flat, Symbols);
+    });
+    report("flat sema", FlatSemantic, FlatNodes, "nodes");
+
+    Measurement FlatGen = measure([&]
+    {
+        CodeGen CG;
+        CG.compile(Flat, llvm::nulls());
+    });
+    report("flat codegen", FlatGen, FlatNodes, "nodes");
+
+    // Folding rewrites the tree, so it runs once, after the incremental
+    // checks above; CodeGen of the result compares with "codegen" above.
+    Sema().semantic(Tree);
+    unsigned Folded = 0;
+    Measurement Fold = measure([&]
+    {
+        Folded = ConstantFold().fold(Tree, Context);
+    }, 1);
+    report("fold", Fold, Folded, "folds");
+
+    Measurement FoldedGen = measure([&]
+    {
+        CodeGen CG;
+        CG.compile(Tree, llvm::nulls());
+    });
+    report("fold codegen", FoldedGen, Nodes, "nodes");
+
+    return 0;
+}
@@ -1,15 +1,69 @@
 #include "CodeGen.h"
-#include "llvm/ADT/StringMap.h"
+#include "RecursiveVisitor.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cassert>
+#include <iterator>
+#include <utility>
+#include <vector>
 
 using namespace llvm;
 
 // Define a visitor class for generating LLVM IR from the AST.
 namespace
 {
-  class ToIRVisitor : public ASTVisitor
+  // Literal exponents up to this are unrolled into multiplications
+  const int MaxUnrolledPower = 16;
+
+  // Base ^ Exp: Exp multiplications of Base, and 1 for Exp <= 0. Like
+  // every +, - and * emitted here it wraps around at 32 bits (no nsw), as
+  // ConstantFold assumes. A literal exponent is unrolled, any other is
+  // counted down in a loop that leaves the builder in its exit block.
+  Value *emitPower(IRBuilder<> &Builder, Value *Base, Value *Exp)
+  {
+    Type *Ty = Base->getType();
+    Value *One = ConstantInt::get(Ty, 1, true);
+    if (auto *Lit = dyn_cast<ConstantInt>(Exp))
+    {
+      int64_t N = Lit->getSExtValue();
+      if (N <= 0)
+        return One;
+      if (N <= MaxUnrolledPower)
+      {
+        Value *Pow = Base;
+        for (int64_t I = 1; I < N; ++I)
+          Pow = Builder.CreateMul(Pow, Base);
+        return Pow;
+      }
+    }
+
+    BasicBlock *Entry = Builder.GetInsertBlock();
+    Function *Fn = Entry->getParent();
+    BasicBlock *Loop = BasicBlock::Create(Fn->getContext(), "pow.loop", Fn);
+    BasicBlock *Done = BasicBlock::Create(Fn->getContext(), "pow.done", Fn);
+    Builder.CreateCondBr(Builder.CreateICmpSGT(Exp, ConstantInt::get(Ty, 0)), Loop, Done);
+
+    Builder.SetInsertPoint(Loop);
+    PHINode *Acc = Builder.CreatePHI(Ty, 2, "pow.acc");
+    PHINode *Count = Builder.CreatePHI(Ty, 2, "pow.count");
+    Value *NextAcc = Builder.CreateMul(Acc, Base);
+    Value *NextCount = Builder.CreateSub(Count, One);
+    Acc->addIncoming(One, Entry);
+    Acc->addIncoming(NextAcc, Loop);
+    Count->addIncoming(Exp, Entry);
+    Count->addIncoming(NextCount, Loop);
+    Builder.CreateCondBr(Builder.CreateICmpSGT(NextCount, ConstantInt::get(Ty, 0)), Loop, Done);
+
+    Builder.SetInsertPoint(Done);
+    PHINode *Pow = Builder.CreatePHI(Ty, 2, "pow");
+    Pow->addIncoming(One, Entry);
+    Pow->addIncoming(NextAcc, Loop);
+    return Pow;
+  }
+
+  class ToIRVisitor : public RecursiveVisitor<ToIRVisitor>
   {
     Module *M;
     IRBuilder<> Builder;
@@ -22,9 +76,144 @@ namespace
     FunctionType *MainFty;
 
     Value *V;
-    StringMap<AllocaInst *> nameMap;
+    std::vector<AllocaInst *> nameMap; // Variable slots, indexed by declaration ID (see DeclTable)
+
+    // Values of expressions already emitted in ReuseBB since the last
+    // store. Shared (hash-consed) nodes are looked up here, so a repeated
+    // subexpression is computed once per basic block.
+    DenseMap<AST *, Value *> Reuse;
+    BasicBlock *ReuseBB = nullptr;
+
+    AllocaInst *&slot(uint32_t Decl)
+    {
+      assert(Decl != DeclTable::None && "variable not resolved by Sema");
+      if (Decl >= nameMap.size())
+        nameMap.resize(Decl + 1, nullptr);
+      return nameMap[Decl];
+    }
+
+    Value *toCond(Value *C)
+    {
+      if (C->getType()->isIntegerTy(1))
+        return C;
+      return Builder.CreateICmpNE(C, ConstantInt::get(C->getType(), 0));
+    }
+
+    Value *emitBinary(Expr &Node, Value *Left, Value *Right)
+    {
+      if (auto *E = dyn_cast<Expression>(&Node))
+        return E->getOperator() == Expression::Plus ? Builder.CreateAdd(Left, Right)
+                                                    : Builder.CreateSub(Left, Right);
+      if (auto *T = dyn_cast<Term>(&Node))
+      {
+        switch (T->getOperator())
+        {
+        case Term::mul:
+          return Builder.CreateMul(Left, Right);
+        case Term::slash:
+          return Builder.CreateSDiv(Left, Right);
+        case Term::mod:
+          return Builder.CreateSRem(Left, Right);
+        }
+      }
+
+      // Perform the binary operation based on the operator type and create the corresponding instruction.
+      BinaryOp &B = cast<BinaryOp>(Node);
+      switch (B.getOperator())
+      {
+      case BinaryOp::Plus:
+        return Builder.CreateAdd(Left, Right);
+      case BinaryOp::Minus:
+        return Builder.CreateSub(Left, Right);
+      case BinaryOp::Mul:
+        return Builder.CreateMul(Left, Right);
+      case BinaryOp::Div:
+        return Builder.CreateSDiv(Left, Right);
+      case BinaryOp::power:
+        return emitPower(Builder, Left, Right);
+      case BinaryOp::mod:
+        return Builder.CreateSRem(Left, Right);
+      case BinaryOp::OR:
+        return Builder.CreateOr(toCond(Left), toCond(Right));
+      case BinaryOp::AND:
+        return Builder.CreateAnd(toCond(Left), toCond(Right));
+      case BinaryOp::is_equal:
+        return Builder.CreateICmpEQ(Left, Right);
+      case BinaryOp::not_equal:
+        return Builder.CreateICmpNE(Left, Right);
+      case BinaryOp::lte:
+        return Builder.CreateICmpSLE(Left, Right);
+      case BinaryOp::gte:
+        return Builder.CreateICmpSGE(Left, Right);
+      case BinaryOp::lt:
+        return Builder.CreateICmpSLT(Left, Right);
+      case BinaryOp::gt:
+        return Builder.CreateICmpSGT(Left, Right);
+      default:
+        return Left;
+      }
+    }
+
+    // Emits an expression with an explicit stack (see walkExpression), so
+    // deeply nested expressions do not recurse
+    Value *emitExpr(Expr *Root)
+    {
+      if (Builder.GetInsertBlock() != ReuseBB)
+      {
+        Reuse.clear();
+        ReuseBB = Builder.GetInsertBlock();
+      }
+      return walkExpression<Value *>(
+          Root,
+          [&](Expr *Node, Value *&Known)
+          {
+            auto It = Reuse.find(Node);
+            if (It == Reuse.end())
+              return false;
+            Known = It->second;
+            return true;
+          },
+          [&](Final &Node)
+          {
+            Value *Val;
+            if (Node.getKind() == Final::Id)
+            {
+              // If the final is an identifier, load its value from memory.
+              Val = Builder.CreateLoad(Int32Ty, slot(Node.getDecl()));
+            }
+            else
+            {
+              // If the final is a literal, convert it to an integer and create a constant.
+              // The parsers reject literals that do not fit.
+              int intval = 0;
+              bool OutOfRange = Node.getVal().getAsInteger(10, intval);
+              assert(!OutOfRange && "integer literal out of range");
+              (void)OutOfRange;
+              Val = ConstantInt::get(Int32Ty, intval, true);
+            }
+            Reuse[&Node] = Val;
+            return Val;
+          },
+          [&](Expr &Node, Value *Left, Value *Right)
+          {
+            Value *Val = emitBinary(Node, Left, Right);
+            Reuse[&Node] = Val;
+            return Val;
+          });
+    }
 
   public:
+    using RecursiveVisitor<ToIRVisitor>::visit;
+
+    // Expressions are emitted iteratively rather than visited
+    void dispatch(AST *Node)
+    {
+      if (isExpressionNode(Node))
+        V = emitExpr(static_cast<Expr *>(Node));
+      else
+        RecursiveVisitor<ToIRVisitor>::dispatch(Node);
+    }
+
     // Constructor for the visitor class.
     ToIRVisitor(Module *M) : M(M), Builder(M->getContext())
     {
@@ -48,183 +237,75 @@ namespace
       Builder.SetInsertPoint(BB);
 
       // Visit the root node of the AST to generate IR.
-      Tree->accept(*this);
+      dispatch(Tree);
 
       // Create a return instruction at the end of the main function.
       Builder.CreateRet(Int32Zero);
     }
 
     // Visit function for the GSM node in the AST.
-    virtual void visit(Goal &Node) override
+    void visit(Goal &Node)
     {
       // Iterate over the children of the GSM node and visit each child.
       for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
       {
-        (*I)->accept(*this);
+        dispatch(*I);
       }
     };
 
-    virtual void visit(Assignment &Node) override
+    void visit(Assignment &Node)
     {
       // Visit the right-hand side of the assignment and get its value.
-      Node.getRight()->accept(*this);
+      dispatch(Node.getRight());
       Value *val = V;
 
-      // Get the name of the variable being assigned.
-      auto varName = Node.getLeft()->getVal();
+      // Get the declaration Sema resolved the variable being assigned to.
+      uint32_t varDecl = Node.getLeft()->getDecl();
 
       // Create a store instruction to assign the value to the variable.
-      Builder.CreateStore(val, nameMap[varName]);
-
-      // Create a function type for the "gsm_write" function.
-      FunctionType *CalcWriteFnTy = FunctionType::get(VoidTy, {Int32Ty}, false);
+      Builder.CreateStore(val, slot(varDecl));
+      Reuse.clear(); // Loads emitted before the store are stale
 
-      // Create a function Define for the "gsm_write" function.
-      Function *CalcWriteFn = Function::Create(CalcWriteFnTy, GlobalValue::ExternalLinkage, "goal_write", M);
-
-      // Create a call instruction to invoke the "gsm_write" function with the value.
-      CallInst *Call = Builder.CreateCall(CalcWriteFnTy, CalcWriteFn, {val});
+      // Declare the "goal_write" runtime function once and call it with the value.
+      FunctionCallee CalcWriteFn =
+          M->getOrInsertFunction("goal_write", FunctionType::get(VoidTy, {Int32Ty}, false));
+      Builder.CreateCall(CalcWriteFn, {val});
     };
 
-    virtual void visit(Final &Node) override
+    // All the names get their slots, holding 0, before any initializer
+    // runs, since Sema lets an initializer read every one of them; then
+    // each initializer is stored in order
+    void visit(Define &Node)
     {
-      if (Node.getKind() == Final::Id)
-      {
-        // If the final is an identifier, load its value from memory.
-        V = Builder.CreateLoad(Int32Ty, nameMap[Node.getVal()]);
-      }
-      else
-      {
-        // If the final is a literal, convert it to an integer and create a constant.
-        int intval;
-        Node.getVal().getAsInteger(10, intval);
-        V = ConstantInt::get(Int32Ty, intval, true);
-      }
-    };
-
-    virtual void visit(BinaryOp &Node) override
-    {
-      // Visit the left-hand side of the binary operation and get its value.
-      Node.getLeft()->accept(*this);
-      Value *Left = V;
-
-      // Visit the right-hand side of the binary operation and get its value.
-      Node.getRight()->accept(*this);
-      Value *Right = V;
-
-      // Perform the binary operation based on the operator type and create the corresponding instruction.
-      switch (Node.getOperator())
+      uint32_t First = Node.getFirstDecl();
+      uint32_t End = First + uint32_t(Node.sym_end() - Node.sym_begin());
+      for (uint32_t Var = First; Var != End; ++Var)
       {
-      case BinaryOp::Plus:
-        V = Builder.CreateNSWAdd(Left, Right);
-        break;
-      case BinaryOp::Minus:
-        V = Builder.CreateNSWSub(Left, Right);
-        break;
-      case BinaryOp::Mul:
-        V = Builder.CreateNSWMul(Left, Right);
-        break;
-      case BinaryOp::Div:
-        V = Builder.CreateSDiv(Left, Right);
-        break;
-      case BinaryOp::power:
-      {
-        V = Left;
-        Final *f = (Final *)Right;
-        int temp;
-        f->getVal().getAsInteger(10, temp);
-        if (f && f->getKind() == Final::ValueKind::Number){
-          int right_value_as_int;
-          f->getVal().getAsInteger(10, right_value_as_int);
-          if(right_value_as_int == 0)
-            V = ConstantInt::get(Int32Ty, 1, true);
-          else{
-            for(int i = 1;i < right_value_as_int;i++){
-              V = Builder.CreateNSWMul(V, Left);
-            }
-          }
-        }
-        break;
-      }
-      case BinaryOp::mod:
-        V = Builder.CreateSRem(Left, Right);
-        break;
-      case BinaryOp::OR:
-        V = Builder.CreateOr(Left, Right);
-        break;
-      case BinaryOp::AND:
-        V = Builder.CreateAnd(Left, Right);
-        break;
-      case BinaryOp::is_equal:
-        V = Builder.CreateICmpEQ(Left, Right);
-        break;
-      case BinaryOp::not_equal:
-        V = Builder.CreateICmpNE(Left, Right);
-        break;
-      case BinaryOp::lte:
-        V = Builder.CreateICmpSGE(Left, Right);
-        break;
-      case BinaryOp::gte:
-        V = Builder.CreateICmpSLE(Left, Right);
-        break;
-      case BinaryOp::lt:
-        V = Builder.CreateICmpSLT(Left, Right);
-        break;
-      case BinaryOp::gt:
-        V = Builder.CreateICmpSGT(Left, Right);
-        break;
+        slot(Var) = Builder.CreateAlloca(Int32Ty);
+        Builder.CreateStore(Int32Zero, slot(Var));
       }
-    };
-
-    virtual void visit(Define &Node) override
-    {
 
-      bool hasValue = false;
-      auto e_I = Node.begin_values(), e_E = Node.end_values();
-      // Iterate over the variables declared in the Define statement.
-      for (auto I = Node.begin(), E = Node.end(); I != E; ++I, ++e_I)
+      uint32_t Var = First;
+      for (auto I = Node.begin_values(), E = Node.end_values(); I != E && Var != End; ++I, ++Var)
       {
-        StringRef Var = *I;
-        Value *val = nullptr;
-        // Create an alloca instruction to allocate memory for the variable.
-        nameMap[Var] = Builder.CreateAlloca(Int32Ty);
-        
-        if (e_I != e_E) 
-        {
-          (* e_I)->accept(*this);
-
-          val = V;
-
-          if (val != nullptr)
-          {
-            Builder.CreateStore(val, nameMap[Var]);
-          }
-        }
-        else if(e_I == e_E || hasValue)
-        {
-          hasValue = true;
-          val = ConstantInt::get(Int32Ty, 0, true);
-          if (val != nullptr)
-          {
-            Builder.CreateStore(val, nameMap[Var]);
-          }
-        }
+        dispatch(*I);
+        Builder.CreateStore(V, slot(Var));
+        Reuse.clear(); // Loads emitted before the store are stale
       }
     };
 
-    virtual void visit(IF &Node) override
+    void visit(IF &Node)
     {
       for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
       {
         if (*I)
         {
-          Assignment *casted_I = (Assignment *)I;
-          casted_I->accept(*this);
+          dispatch(*I);
         }
       }
     };
 
-    virtual void visit(Loop &Node) override
+    void visit(Loop &Node)
     {
       llvm::BasicBlock* WhileCondBB = llvm::BasicBlock::Create(M->getContext(), "loopc.cond", MainFn);
       llvm::BasicBlock* WhileBodyBB = llvm::BasicBlock::Create(M->getContext(), "loopc.body", MainFn);
@@ -232,14 +313,14 @@ namespace
 
       Builder.CreateBr(WhileCondBB);
       Builder.SetInsertPoint(WhileCondBB);
-      Node.getExprs()->accept(*this);
-      Value* val=V;
+      dispatch(Node.getExprs());
+      Value* val=toCond(V);
       Builder.CreateCondBr(val, WhileBodyBB, AfterWhileBB);
       Builder.SetInsertPoint(WhileBodyBB);
       IF *F = Node.getIF();
       
       for (auto I = F->begin(), E = F->end(); I != E; ++I){
-        (*I)->accept(*this);
+        dispatch(*I);
       }
 
       Builder.CreateBr(WhileCondBB);
@@ -248,64 +329,280 @@ namespace
 
     };
 
-    virtual void visit(Condition &Node) override
+    void visit(Condition &Node)
+    {
+      // One test per if/elif; a false test falls through to the next one,
+      // and the last to the else block if there is one.
+      llvm::BasicBlock* AfterIfBB = llvm::BasicBlock::Create(M->getContext(), "after.if");
+      auto Body = Node.assignments_begin(), BodyEnd = Node.assignments_end();
+      for (auto I = Node.exprs_begin(), E = Node.exprs_end(); I != E && Body != BodyEnd; ++I, ++Body)
+      {
+        llvm::BasicBlock* ifBodyBB = llvm::BasicBlock::Create(M->getContext(), "if.body", MainFn);
+        llvm::BasicBlock* ifNextBB = llvm::BasicBlock::Create(M->getContext(), "if.next", MainFn);
+        dispatch(*I);
+        Builder.CreateCondBr(toCond(V), ifBodyBB, ifNextBB);
+
+        Builder.SetInsertPoint(ifBodyBB);
+        dispatch(*Body);
+        Builder.CreateBr(AfterIfBB);
+        Builder.SetInsertPoint(ifNextBB);
+      }
+      if (Body != BodyEnd)
+        dispatch(*Body); // else
+      Builder.CreateBr(AfterIfBB);
+
+      AfterIfBB->insertInto(MainFn);
+      Builder.SetInsertPoint(AfterIfBB);
+    };
+  };
+}
+
+void CodeGen::compile(AST *Tree, raw_ostream &OS)
+{
+  // Create an LLVM context and a module.
+  LLVMContext Ctx;
+  Module *M = new Module("calc.expr", Ctx);
+
+  // Create an instance of the ToIRVisitor and run it on the AST to generate LLVM IR.
+  ToIRVisitor ToIR(M);
+  ToIR.run(Tree);
+
+  // Print the generated module to the requested stream.
+  M->print(OS, nullptr);
+}
+
+// Lowers a FlatAST front to back. Values[N] holds the IR value of node N;
+// control-flow markers keep the blocks of open loops and chains on a stack.
+namespace
+{
+  class FlatToIR
+  {
+    const FlatAST &Flat;
+    Module *M;
+    IRBuilder<> Builder;
+    Type *Int32Ty;
+    Function *MainFn = nullptr;
+    FunctionCallee WriteFn;
+    std::vector<Value *> Values;
+    std::vector<AllocaInst *> nameMap; // Variable slots, indexed by interned symbol ID
+
+    // Head is the loop condition block, Next the block taking the next
+    // branch of a chain (null once the else body started), Exit the
+    // block after the construct.
+    struct Frame
+    {
+      BasicBlock *Head;
+      BasicBlock *Next;
+      BasicBlock *Exit;
+    };
+    std::vector<Frame> Open;
+
+    AllocaInst *&slot(uint32_t Sym)
+    {
+      assert(Sym != SymbolTable::None && "not an interned identifier");
+      if (Sym >= nameMap.size())
+        nameMap.resize(Sym + 1, nullptr);
+      return nameMap[Sym];
+    }
+
+    // Blocks are created detached and placed when entered, so the
+    // function body reads in source order
+    BasicBlock *block(const char *Name)
+    {
+      return BasicBlock::Create(M->getContext(), Name);
+    }
+
+    void enter(BasicBlock *BB)
+    {
+      if (!BB->getParent())
+        BB->insertInto(MainFn);
+      Builder.SetInsertPoint(BB);
+    }
+
+    Value *toCond(Value *C)
+    {
+      if (C->getType()->isIntegerTy(1))
+        return C;
+      return Builder.CreateICmpNE(C, ConstantInt::get(C->getType(), 0));
+    }
+
+    Value *binary(uint8_t Op, uint32_t L, uint32_t R)
+    {
+      Value *Left = Values[L], *Right = Values[R];
+      switch (Op)
+      {
+      case BinaryOp::Plus:
+        return Builder.CreateAdd(Left, Right);
+      case BinaryOp::Minus:
+        return Builder.CreateSub(Left, Right);
+      case BinaryOp::Mul:
+        return Builder.CreateMul(Left, Right);
+      case BinaryOp::Div:
+        return Builder.CreateSDiv(Left, Right);
+      case BinaryOp::mod:
+        return Builder.CreateSRem(Left, Right);
+      case BinaryOp::power:
+        return emitPower(Builder, Left, Right);
+      case BinaryOp::OR:
+        return Builder.CreateOr(toCond(Left), toCond(Right));
+      case BinaryOp::AND:
+        return Builder.CreateAnd(toCond(Left), toCond(Right));
+      case BinaryOp::is_equal:
+        return Builder.CreateICmpEQ(Left, Right);
+      case BinaryOp::not_equal:
+        return Builder.CreateICmpNE(Left, Right);
+      case BinaryOp::lte:
+        return Builder.CreateICmpSLE(Left, Right);
+      case BinaryOp::gte:
+        return Builder.CreateICmpSGE(Left, Right);
+      case BinaryOp::lt:
+        return Builder.CreateICmpSLT(Left, Right);
+      case BinaryOp::gt:
+        return Builder.CreateICmpSGT(Left, Right);
+      }
+      return Left;
+    }
+
+  public:
+    FlatToIR(const FlatAST &Flat, Module *M)
+        : Flat(Flat), M(M), Builder(M->getContext())
     {
+      Int32Ty = Type::getInt32Ty(M->getContext());
+    }
 
-      Value *val = nullptr;
-      int count_exprs = 0;
-      int count_Assignments = 0;
-      bool hasIf = true;
-      bool endOfCondition = false;
-      llvm::BasicBlock* ifcondBB;
-      llvm::BasicBlock* ifBodyBB;
-      for (auto I = Node.exprs_begin(), E = Node.exprs_end(); I != E; ++I)
+    void run()
+    {
+      Type *Int8PtrPtrTy = Type::getInt8PtrTy(M->getContext())->getPointerTo();
+      FunctionType *MainFty = FunctionType::get(Int32Ty, {Int32Ty, Int8PtrPtrTy}, false);
+      MainFn = Function::Create(MainFty, GlobalValue::ExternalLinkage, "main", M);
+      WriteFn = M->getOrInsertFunction(
+          "goal_write", FunctionType::get(Type::getVoidTy(M->getContext()), {Int32Ty}, false));
+      enter(block("entry"));
+
+      // As in the tree CodeGen, a Define's slots hold 0 before its first
+      // initializer runs, and each initializer is stored as soon as it is
+      // computed. Initializers precede the Define node, so the slots are
+      // made where Sema brings the names into scope (FlatAST::firstNode).
+      std::vector<std::pair<size_t, size_t>> Starts; // (first node, Define)
+      std::vector<std::pair<size_t, uint32_t>> Inits; // (initializer, symbol)
+      for (size_t N = 0, E = Flat.size(); N != E; ++N)
       {
-        count_exprs++;
+        if (Flat.Kinds[N] != FlatAST::Define || !Flat.B[N])
+          continue;
+        uint32_t A = Flat.A[N], B = Flat.B[N];
+        if (Flat.Extra[A + B] != FlatAST::None)
+          Starts.emplace_back(Flat.firstNode(Flat.Extra[A + B]), N);
+        for (uint32_t I = 0; I < B && Flat.Extra[A + B + I] != FlatAST::None; ++I)
+          Inits.emplace_back(Flat.Extra[A + B + I], Flat.Extra[A + I]);
       }
-      for (auto I = Node.assignments_begin(), E = Node.assignments_end(); I != E; ++I)
+      auto NextStart = Starts.begin();
+      auto NextInit = Inits.begin();
+
+      Values.assign(Flat.size(), nullptr);
+      for (size_t N = 0, E = Flat.size(); N != E; ++N)
       {
-        count_Assignments++;
+        if (NextStart != Starts.end() && NextStart->first == N)
+          declare((NextStart++)->second);
+        // without initializers, nothing was declared early
+        if (Flat.Kinds[N] == FlatAST::Define &&
+            (NextStart == Starts.begin() || std::prev(NextStart)->second != N))
+          declare(N);
+        lower(N);
+        if (NextInit != Inits.end() && NextInit->first == N)
+          Builder.CreateStore(Values[N], slot((NextInit++)->second));
       }
-      IF* Assignments_I = *(Node.getAllAssignments().begin()), *Assignments_E = *(Node.getAllAssignments().end());
-      for (auto I = Node.exprs_begin(), E = Node.exprs_begin(); I != E; ++I, ++Assignments_I)
+
+      Builder.CreateRet(ConstantInt::get(Int32Ty, 0, true));
+    }
+
+    // Makes the slots of the names Define N declares, holding 0
+    void declare(size_t N)
+    {
+      for (uint32_t I = Flat.A[N], End = Flat.A[N] + Flat.B[N]; I != End; ++I)
       {
-    
-        if (hasIf)
-        {
-          ifcondBB = llvm::BasicBlock::Create(M -> getContext(), "if.condition", MainFn);
-          
-          (*I)->accept(*this);
-          val = V;
-          
-          ifBodyBB = llvm::BasicBlock::Create(M -> getContext(), "if.Body", MainFn);
-          hasIf = false;
-
-          for (auto F = Assignments_I->begin(), G = Assignments_I->end(); G != F; ++F){
-            (*F)->accept(*this);
-          }
+        AllocaInst *&Slot = slot(Flat.Extra[I]);
+        Slot = Builder.CreateAlloca(Int32Ty);
+        Builder.CreateStore(ConstantInt::get(Int32Ty, 0, true), Slot);
+      }
+    }
 
-        }
+    void lower(size_t N)
+    {
+      uint32_t A = Flat.A[N], B = Flat.B[N];
+      switch (Flat.Kinds[N])
+      {
+      case FlatAST::Number:
+        Values[N] = ConstantInt::get(Int32Ty, int(A), true);
+        break;
+      case FlatAST::Ident:
+        Values[N] = Builder.CreateLoad(Int32Ty, slot(A));
+        break;
+      case FlatAST::Binary:
+        Values[N] = binary(Flat.Ops[N], A, B);
+        break;
+      case FlatAST::Define: // see run()
+        break;
+      case FlatAST::Assign:
+        Builder.CreateStore(Values[B], slot(A));
+        Builder.CreateCall(WriteFn, {Values[B]});
+        break;
+      case FlatAST::LoopBegin:
+      {
+        BasicBlock *Head = block("loopc.cond");
+        Builder.CreateBr(Head);
+        enter(Head);
+        Open.push_back({Head, nullptr, nullptr});
+        break;
       }
-      if (count_Assignments + 1 == count_exprs)
+      case FlatAST::LoopTest:
       {
-        auto Assignmentse = Node.Assignments_end();
-        (*Assignmentse)->accept(*this);
+        BasicBlock *Body = block("loopc.body");
+        Open.back().Exit = block("loopc.end");
+        Builder.CreateCondBr(toCond(Values[A]), Body, Open.back().Exit);
+        enter(Body);
+        break;
       }
-    
-    };
+      case FlatAST::LoopEnd:
+        Builder.CreateBr(Open.back().Head);
+        enter(Open.back().Exit);
+        Open.pop_back();
+        break;
+      case FlatAST::CondBegin:
+        Open.push_back({nullptr, nullptr, block("if.end")});
+        break;
+      case FlatAST::CondTest:
+      {
+        BasicBlock *Then = block("if.body");
+        Open.back().Next = block("if.next");
+        Builder.CreateCondBr(toCond(Values[A]), Then, Open.back().Next);
+        enter(Then);
+        break;
+      }
+      case FlatAST::CondElse:
+        Open.back().Next = nullptr;
+        break;
+      case FlatAST::BranchEnd:
+        Builder.CreateBr(Open.back().Exit);
+        enter(Open.back().Next ? Open.back().Next : Open.back().Exit);
+        break;
+      case FlatAST::CondEnd:
+        if (Open.back().Next)
+          Builder.CreateBr(Open.back().Exit);
+        enter(Open.back().Exit);
+        Open.pop_back();
+        break;
+      }
+    }
   };
-}; 
+}
 
-void CodeGen::compile(AST *Tree)
+void CodeGen::compile(const FlatAST &Flat, raw_ostream &OS)
 {
-  // Create an LLVM context and a module.
   LLVMContext Ctx;
   Module *M = new Module("calc.expr", Ctx);
 
-  // Create an instance of the ToIRVisitor and run it on the AST to generate LLVM IR.
-  ToIRVisitor ToIR(M);
-  ToIR.run(Tree);
+  FlatToIR ToIR(Flat, M);
+  ToIR.run();
 
-  // Print the generated module to the standard output.
-  M->print(outs(), nullptr);
-}
\ No newline at end of file
+  M->print(OS, nullptr);
+}
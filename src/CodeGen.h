@@ -2,11 +2,17 @@
 #define CODEGEN_H
 
 #include "AST.h"
+#include "FlatAST.h"
+#include "llvm/Support/raw_ostream.h"
 
 class CodeGen
 {
 public:
- void compile(AST *Tree);
+ // Prints the generated module to OS; variables are looked up by the
+ // declarations Sema attached to the tree, so Tree must have passed Sema
+ void compile(AST *Tree, llvm::raw_ostream &OS = llvm::outs());
+ // Same, from a flattened tree in one forward scan
+ void compile(const FlatAST &Flat, llvm::raw_ostream &OS = llvm::outs());
 
 };
 #endif
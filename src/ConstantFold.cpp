@@ -0,0 +1,217 @@
+#include "ConstantFold.h"
+#include "RecursiveVisitor.h"
+#include "llvm/ADT/Optional.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using llvm::cast;
+using llvm::dyn_cast;
+using llvm::isa;
+
+namespace {
+// Value of each declaration at the current point, indexed by declaration
+// ID; None where it is not known at compile time
+using ValueMap = std::vector<llvm::Optional<int32_t>>;
+
+// Value of a literal, read the way CodeGen reads it
+bool getLiteral(Expr *E, int32_t &Value) {
+  auto *F = dyn_cast<Final>(E);
+  int V;
+  if (!F || F->getKind() != Final::Number || F->getVal().getAsInteger(10, V))
+    return false;
+  Value = V;
+  return true;
+}
+
+// Evaluates L Op R as the IR CodeGen emits does, wrapping around at 32
+// bits; false where that IR has no defined value. '^' is handled by the
+// caller.
+bool evaluate(BinaryOp::Operator Op, int32_t L, int32_t R, int32_t &Res) {
+  uint32_t UL = uint32_t(L), UR = uint32_t(R);
+  switch (Op) {
+  case BinaryOp::Plus: Res = int32_t(UL + UR); return true;
+  case BinaryOp::Minus: Res = int32_t(UL - UR); return true;
+  case BinaryOp::Mul: Res = int32_t(UL * UR); return true;
+  case BinaryOp::Div:
+  case BinaryOp::mod:
+    if (R == 0 || (L == INT32_MIN && R == -1))
+      return false;
+    Res = Op == BinaryOp::Div ? L / R : L % R;
+    return true;
+  case BinaryOp::is_equal: Res = L == R; return true;
+  case BinaryOp::not_equal: Res = L != R; return true;
+  case BinaryOp::lt: Res = L < R; return true;
+  case BinaryOp::lte: Res = L <= R; return true;
+  case BinaryOp::gt: Res = L > R; return true;
+  case BinaryOp::gte: Res = L >= R; return true;
+  case BinaryOp::AND: Res = L != 0 && R != 0; return true;
+  case BinaryOp::OR: Res = L != 0 || R != 0; return true;
+  default: return false;
+  }
+}
+
+// Base ^ Exp for Exp >= 1, by squaring; the same as CodeGen's Exp
+// multiplications modulo 2^32
+int32_t power(int32_t Base, int32_t Exp) {
+  uint32_t Res = 1, B = uint32_t(Base);
+  for (uint32_t E = uint32_t(Exp); E; E >>= 1) {
+    if (E & 1)
+      Res *= B;
+    B *= B;
+  }
+  return int32_t(Res);
+}
+
+class Folder : public RecursiveVisitor<Folder> {
+  ASTContext &Ctx;
+  ValueMap Values;
+  unsigned NumFolded = 0;
+
+  llvm::Optional<int32_t> &valueOf(uint32_t Decl) {
+    if (Decl >= Values.size())
+      Values.resize(Decl + 1);
+    return Values[Decl];
+  }
+
+  Expr *literal(int32_t Value, uint32_t Loc) {
+    ++NumFolded;
+    return Ctx.getNumber(Value, Loc);
+  }
+
+  // Variables assigned in Block lose their known values
+  void forgetAssigned(IF &Block) {
+    for (auto I = Block.begin(), E = Block.end(); I != E; ++I)
+      valueOf(cast<Assignment>(*I)->getLeft()->getDecl()).reset();
+  }
+
+  // Keeps the values all of Paths agree on
+  void meet(const std::vector<ValueMap> &Paths) {
+    Values = Paths.front();
+    for (const ValueMap &P : Paths) {
+      Values.resize(std::max(Values.size(), P.size()));
+      for (size_t D = 0; D < Values.size(); ++D)
+        if (D >= P.size() || Values[D] != P[D])
+          Values[D].reset();
+    }
+  }
+
+public:
+  using RecursiveVisitor<Folder>::visit;
+
+  Folder(ASTContext &Ctx) : Ctx(Ctx) {}
+
+  unsigned getNumFolded() { return NumFolded; }
+
+  // Rewrites E bottom-up: variables with known values become literals and
+  // operators on literals are evaluated. Nodes may be shared by several
+  // expressions (see ASTContext), so they are never changed; a node with
+  // a rewritten operand is replaced by a new one.
+  Expr *foldExpr(Expr *E) {
+    return walkExpression<Expr *>(
+        E, [](Expr *, Expr *&) { return false; },
+        [&](Final &Node) -> Expr * {
+          if (Node.getKind() != Final::Id || Node.getDecl() == DeclTable::None)
+            return &Node;
+          llvm::Optional<int32_t> V = valueOf(Node.getDecl());
+          return V ? literal(*V, Node.getLoc()) : &Node;
+        },
+        [&](Expr &Node, Expr *L, Expr *R) -> Expr * {
+          BinaryOp::Operator Op = getBinaryOperator(&Node);
+          int32_t LV, RV, Res;
+          if (Op == BinaryOp::power) {
+            // CodeGen raises to any exponent, giving 1 for one <= 0. The
+            // base is evaluated all the same, so it is only dropped if it
+            // cannot trap.
+            if (getLiteral(R, RV)) {
+              if (RV <= 0 && isa<Final>(L))
+                return literal(1, Node.getLoc());
+              if (RV > 0 && getLiteral(L, LV))
+                return literal(power(LV, RV), Node.getLoc());
+            }
+          } else if (getLiteral(L, LV) && getLiteral(R, RV) && evaluate(Op, LV, RV, Res)) {
+            return literal(Res, Node.getLoc());
+          } else if ((Op == BinaryOp::Div || Op == BinaryOp::mod) && getLiteral(R, RV) &&
+                     RV == 0) {
+            // Kept as written: a literal 0 divisor is a Sema error, and
+            // the division must still trap at run time rather than be
+            // folded away by the IR builder
+            return &Node;
+          }
+          if (L == getLeftOperand(&Node) && R == getRightOperand(&Node))
+            return &Node;
+          return Ctx.getBinaryOp(Op, L, R, Node.getLoc());
+        });
+  }
+
+  // Every name is 0 until its initializer, which may read any of them, is
+  // stored; initializers run in order (see CodeGen)
+  void visit(Define &Node) {
+    uint32_t First = Node.getFirstDecl();
+    uint32_t End = First + uint32_t(Node.sym_end() - Node.sym_begin());
+    for (uint32_t Decl = First; Decl != End; ++Decl)
+      valueOf(Decl) = 0;
+    uint32_t Decl = First;
+    size_t Idx = 0;
+    for (auto V = Node.begin_values(), VE = Node.end_values(); V != VE && Decl != End;
+         ++V, ++Decl) {
+      Expr *Init = foldExpr(*V);
+      Node.setValue(Idx++, Init);
+      int32_t Value;
+      valueOf(Decl) = getLiteral(Init, Value) ? llvm::Optional<int32_t>(Value) : llvm::None;
+    }
+  }
+
+  void visit(Assignment &Node) {
+    Expr *RHS = foldExpr(Node.getRight());
+    Node.setRight(RHS);
+    int32_t Value;
+    valueOf(Node.getLeft()->getDecl()) =
+        getLiteral(RHS, Value) ? llvm::Optional<int32_t>(Value) : llvm::None;
+  }
+
+  // The body may run any number of times, so what it assigns is unknown
+  // at the test, in the body and after the loop
+  void visit(Loop &Node) {
+    forgetAssigned(*Node.getIF());
+    Node.setExprs(foldExpr(Node.getExprs()));
+    dispatch(Node.getIF());
+    forgetAssigned(*Node.getIF());
+  }
+
+  // Every test sees the values from before the statement; afterwards a
+  // value is known if each branch, and falling through without an else,
+  // leaves it the same
+  void visit(Condition &Node) {
+    ValueMap Entry = Values;
+    std::vector<ValueMap> Exits;
+    auto B = Node.assignments_begin(), BE = Node.assignments_end();
+    size_t Idx = 0;
+    for (auto C = Node.exprs_begin(), CE = Node.exprs_end(); C != CE; ++C, ++B, ++Idx) {
+      Values = Entry;
+      Node.setExpr(Idx, foldExpr(*C));
+      dispatch(*B);
+      Exits.push_back(Values);
+    }
+    Values = Entry;
+    if (B != BE)
+      dispatch(*B);
+    Exits.push_back(Values);
+    meet(Exits);
+  }
+
+  // Expressions outside statements are not rewritten
+  void visit(Final &) {}
+  void visit(BinaryOp &) {}
+  void visit(Expression &) {}
+  void visit(Term &) {}
+};
+}
+
+unsigned ConstantFold::fold(AST *Tree, ASTContext &Ctx) {
+  if (!Tree)
+    return 0;
+  Folder F(Ctx);
+  F.dispatch(Tree);
+  return F.getNumFolded();
+}
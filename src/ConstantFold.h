@@ -0,0 +1,17 @@
+#ifndef CONSTANTFOLD_H
+#define CONSTANTFOLD_H
+
+#include "AST.h"
+#include "ASTContext.h"
+
+class ConstantFold {
+public:
+  // Replaces expressions whose value is known at compile time by literals
+  // allocated in Ctx, propagating variable values through the program.
+  // Tree must have passed Sema, whose declarations it follows. Statements
+  // are rewritten in place, so a tree kept for IncrementalSema is folded
+  // only after its last check. Returns the number of expressions replaced.
+  unsigned fold(AST *Tree, ASTContext &Ctx);
+};
+
+#endif
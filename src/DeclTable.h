@@ -0,0 +1,89 @@
+#ifndef DECLTABLE_H
+#define DECLTABLE_H
+
+#include "SymbolTable.h"
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// DeclTable numbers the declarations of a program with dense IDs in the
+// order they are seen and resolves interned symbols (see SymbolTable) to
+// them. The current declaration of every symbol is kept in a flat array
+// indexed by symbol ID, so a lookup is one load. Only top-level Defines
+// declare names (blocks hold assignments), so there is a single scope.
+//
+// A table may also start part-way through a program (see Sema's parallel
+// check): it is given the bindings in effect there and the ID of the next
+// declaration, and keeps records only from that ID on.
+class DeclTable
+{
+public:
+    static const uint32_t None = ~0u; // unresolved
+
+    struct Decl
+    {
+        uint32_t Sym;
+        uint32_t Loc; // of the declaring statement
+    };
+
+private:
+    uint32_t Base = 0;              // ID of Decls[0]
+    std::vector<Decl> Decls;
+    std::vector<uint32_t> Bindings; // declaration by symbol ID
+
+    void grow(uint32_t Sym)
+    {
+        assert(Sym != SymbolTable::None && "not an interned identifier");
+        if (Sym >= Bindings.size())
+            Bindings.resize(Sym + 1, uint32_t(None)); // a copy: None has no definition
+    }
+
+public:
+    DeclTable() = default;
+
+    // continues after the declarations Bindings, the last of which has
+    // ID Base - 1
+    DeclTable(std::vector<uint32_t> Bindings, uint32_t Base)
+        : Base(Base), Bindings(std::move(Bindings)) {}
+
+    uint32_t lookup(uint32_t Sym) const { return Sym < Bindings.size() ? Bindings[Sym] : None; }
+
+    // adds a declaration of Sym and returns its ID
+    uint32_t declare(uint32_t Sym, uint32_t Loc)
+    {
+        grow(Sym);
+        uint32_t ID = uint32_t(size());
+        Decls.push_back({Sym, Loc});
+        Bindings[Sym] = ID;
+        return ID;
+    }
+
+    // adds a declaration of Sym with the given ID rather than the next
+    // one (IncrementalSema keeps IDs stable across versions and reuses
+    // those of removed declarations)
+    void declare(uint32_t Sym, uint32_t Loc, uint32_t ID)
+    {
+        assert(ID >= Base && "record before the table");
+        grow(Sym);
+        if (ID - Base >= Decls.size())
+            Decls.resize(ID - Base + 1, Decl{uint32_t(SymbolTable::None), 0});
+        Decls[ID - Base] = {Sym, Loc};
+        Bindings[Sym] = ID;
+    }
+
+    // binds Sym to ID, a declaration made before Base or recorded
+    // elsewhere
+    void bind(uint32_t Sym, uint32_t ID)
+    {
+        grow(Sym);
+        Bindings[Sym] = ID;
+    }
+
+    // only IDs from Base on have a record here
+    const Decl &operator[](uint32_t ID) const { return Decls[ID - Base]; }
+
+    size_t size() const { return Base + Decls.size(); }
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "Driver.h"
+#include "ASTCache.h"
+#include "CodeGen.h"
+#include "ConstantFold.h"
+#include "LLParser.h"
+#include "Parser.h"
+#include "Sema.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+// Checks and compiles a flattened program.
+static bool compileFlat(const FlatAST &FlatTree, const SymbolTable &Symbols, const LineTable *Lines,
+                        llvm::raw_ostream &OS)
+{
+    if (Sema().semantic(FlatTree, Symbols, Lines))
+    {
+        llvm::errs() << "Semantic errors occurred\n";
+        return false;
+    }
+    CodeGen().compile(FlatTree, OS);
+    return true;
+}
+
+bool compileProgram(llvm::StringRef InputFilename, const DriverOptions &Opts, llvm::raw_ostream &OS)
+{
+    std::unique_ptr<llvm::MemoryBuffer> InputBuffer;
+    std::unique_ptr<Lexer> Lex;
+    std::unique_ptr<TokenStream> Tokens;
+    std::unique_ptr<StreamingLexer> ChunkedLex;
+    llvm::BumpPtrAllocator TextAlloc;
+    llvm::StringSaver TextSaver(TextAlloc);
+    std::unique_ptr<LineTable> Lines;
+    SymbolTable Symbols; // identifiers interned by the lexer, used by Sema and CodeGen
+    ASTContext Context; // owns the tree until CodeGen is done
+    std::unique_ptr<::Parser> Parser;
+    std::unique_ptr<ASTCache> Cache;
+    llvm::sys::fs::file_t StreamFile = llvm::sys::fs::kInvalidFile; // opened for -stream
+    // Shared nodes would be resolved by several Sema threads at once
+    Context.setShareExprs(Opts.ShareExprs && Opts.SemaThreads <= 1);
+
+    if (Opts.Stream)
+    {
+        // Read the input chunk by chunk, saving identifier texts for the AST.
+        llvm::sys::fs::file_t File = llvm::sys::fs::getStdinHandle();
+        if (InputFilename != "-")
+        {
+            llvm::Expected<llvm::sys::fs::file_t> FileOrErr =
+                llvm::sys::fs::openNativeFileForRead(InputFilename);
+            if (!FileOrErr)
+            {
+                llvm::errs() << "Error reading " << InputFilename << ": "
+                             << llvm::toString(FileOrErr.takeError()) << "\n";
+                return false;
+            }
+            File = StreamFile = *FileOrErr;
+        }
+        ChunkedLex = std::make_unique<StreamingLexer>(File, Opts.StreamChunkSize, &TextSaver,
+                                                      &Symbols);
+        Parser = std::make_unique<::Parser>(*ChunkedLex, Context);
+    }
+    else
+    {
+        // Read the whole input; large files are mmap'ed rather than copied.
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileOrErr =
+            llvm::MemoryBuffer::getFileOrSTDIN(InputFilename);
+        if (std::error_code EC = FileOrErr.getError())
+        {
+            llvm::errs() << "Error reading " << InputFilename << ": "
+                         << EC.message() << "\n";
+            return false;
+        }
+        InputBuffer = std::move(*FileOrErr);
+        Lines = std::make_unique<LineTable>(InputBuffer->getBuffer());
+
+        // An unchanged input skips lexing and parsing altogether.
+        if (!Opts.ASTCacheDir.empty())
+        {
+            Cache = std::make_unique<ASTCache>(Opts.ASTCacheDir, InputBuffer->getBuffer(),
+                                               Opts.FoldConstants ? uint32_t(ASTCache::FoldedConstants)
+                                                                  : uint32_t(0));
+            FlatAST Cached;
+            if (Cache->load(Cached, Symbols))
+                return compileFlat(Cached, Symbols, Lines.get(), OS);
+        }
+
+        // Create a lexer object that views the buffer in place (it is NUL terminated).
+        Lex = std::make_unique<Lexer>(InputBuffer->getBuffer(), &Symbols);
+
+        // Create a parser object and initialize it with the lexer, or with the
+        // pre-lexed token stream when requested.
+        if (Opts.LexThreads > 1)
+            Tokens = std::make_unique<TokenStream>(InputBuffer->getBuffer(), Opts.LexThreads, &Symbols);
+        else if (Opts.PreLex || Opts.ParseThreads > 1)
+            Tokens = std::make_unique<TokenStream>(*Lex);
+
+        if (Tokens)
+            Parser = std::make_unique<::Parser>(*Tokens, Context);
+        else if (!Opts.TableDriven)
+            Parser = std::make_unique<::Parser>(*Lex, Context);
+    }
+
+    // Chunked input is gone by the time a diagnostic is printed, so it
+    // reports raw offsets.
+    if (Parser)
+        Parser->setLineTable(Lines.get());
+
+    // Parse the input expression and generate an abstract syntax tree (AST).
+    AST *Tree;
+    bool HasSyntaxError;
+    if (Tokens && Opts.ParseThreads > 1)
+        Tree = ::Parser::parseParallel(*Tokens, Context, Opts.ParseThreads, Lines.get(), HasSyntaxError);
+    else if (!Parser)
+    {
+        LLParser TableParser(*Lex, Context);
+        TableParser.setLineTable(Lines.get());
+        Tree = TableParser.parse();
+        HasSyntaxError = TableParser.hasError();
+    }
+    else
+    {
+        Tree = Parser->parse();
+        HasSyntaxError = Parser->hasError();
+    }
+
+    // The chunked input has been read to its end.
+    if (StreamFile != llvm::sys::fs::kInvalidFile)
+        llvm::sys::fs::closeFile(StreamFile);
+
+    // Check if parsing was successful or if there were any syntax errors.
+    if (!Tree || HasSyntaxError || (ChunkedLex && ChunkedLex->hasReadError()))
+    {
+        llvm::errs() << "Syntax errors occurred\n";
+        return false;
+    }
+
+    // Perform semantic analysis on the AST. Folding follows the
+    // declarations it resolves, so it is needed on the flat path as well.
+    Sema Semantic;
+    if ((Opts.FoldConstants || !(Opts.Flat || Cache)) &&
+        Semantic.semantic(Tree, Lines.get(), Opts.SemaThreads))
+    {
+        llvm::errs() << "Semantic errors occurred\n";
+        return false;
+    }
+
+    if (Opts.FoldConstants)
+        ConstantFold().fold(Tree, Context);
+
+    if (Opts.Flat || Cache)
+    {
+        FlatAST FlatTree(Tree);
+        if (Cache)
+            Cache->store(FlatTree, Symbols);
+        return compileFlat(FlatTree, Symbols, Lines.get(), OS);
+    }
+
+    // Generate code for the AST using a code generator.
+    CodeGen CodeGenerator;
+    CodeGenerator.compile(Tree, OS);
+    return true;
+}
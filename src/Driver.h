@@ -0,0 +1,32 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstddef>
+#include <string>
+
+// How a program is compiled; each field is the goal option of the same
+// name (see Goal.cpp).
+struct DriverOptions
+{
+    bool PreLex = false;
+    unsigned LexThreads = 1;
+    unsigned ParseThreads = 1;
+    unsigned SemaThreads = 1;
+    bool Stream = false;
+    size_t StreamChunkSize = 64 * 1024;
+    bool Flat = false;
+    std::string ASTCacheDir; // no cache if empty
+    bool ShareExprs = false;
+    bool TableDriven = false;
+    bool FoldConstants = false;
+};
+
+// Compiles the program in InputFilename ("-" reads stdin) from parsing to
+// CodeGen, as goal does, and prints its module to OS. Diagnostics go to
+// llvm::errs(); returns false if there were any.
+bool compileProgram(llvm::StringRef InputFilename, const DriverOptions &Opts,
+                    llvm::raw_ostream &OS = llvm::outs());
+
+#endif
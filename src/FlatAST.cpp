@@ -0,0 +1,126 @@
+#include "FlatAST.h"
+#include "RecursiveVisitor.h"
+
+namespace
+{
+    // Appends nodes in post-order; Last is the index of the node just
+    // produced, or None for statements that produce no value.
+    class FlatBuilder : public ASTVisitor
+    {
+        FlatAST &F;
+        uint32_t Last = FlatAST::None;
+        int32_t LocDelta = 0;
+
+        uint32_t loc(AST &Node) { return Node.getLoc() + LocDelta; }
+
+        // expressions are appended by an iterative walk, statements by
+        // visiting them
+        uint32_t flatten(Expr *E)
+        {
+            if (isExpressionNode(E))
+                return Last = walkExpression<uint32_t>(
+                           E, [](Expr *, uint32_t &) { return false; },
+                           [&](Final &Node) { return leaf(Node); },
+                           [&](Expr &Node, uint32_t L, uint32_t R)
+                           { return F.add(FlatAST::Binary, getBinaryOperator(&Node), L, R, loc(Node)); });
+            E->accept(*this);
+            return Last;
+        }
+
+        uint32_t leaf(Final &Node)
+        {
+            if (Node.getKind() == Final::Id)
+                return F.add(FlatAST::Ident, 0, Node.getSym(), 0, loc(Node));
+            int Val = 0;
+            Node.getVal().getAsInteger(10, Val);
+            return F.add(FlatAST::Number, 0, uint32_t(Val), 0, loc(Node));
+        }
+
+    public:
+        FlatBuilder(FlatAST &F) : F(F) {}
+
+        virtual void visit(Goal &Node) override
+        {
+            size_t Idx = 0;
+            for (auto I = Node.begin(), E = Node.end(); I != E; ++I, ++Idx)
+            {
+                LocDelta = Node.getLocDelta(Idx);
+                flatten(*I);
+            }
+            LocDelta = 0;
+            Last = FlatAST::None;
+        }
+
+        virtual void visit(Final &Node) override { flatten(&Node); }
+        virtual void visit(BinaryOp &Node) override { flatten(&Node); }
+        virtual void visit(Expression &Node) override { flatten(&Node); }
+        virtual void visit(Term &Node) override { flatten(&Node); }
+
+        virtual void visit(Define &Node) override
+        {
+            llvm::SmallVector<uint32_t, 8> Inits;
+            for (auto I = Node.begin_values(), E = Node.end_values(); I != E; ++I)
+                Inits.push_back(flatten(*I));
+
+            uint32_t First = uint32_t(F.Extra.size());
+            uint32_t Count = uint32_t(Node.sym_end() - Node.sym_begin());
+            F.Extra.append(Node.sym_begin(), Node.sym_end());
+            for (uint32_t I = 0; I < Count; ++I)
+                F.Extra.push_back(I < Inits.size() ? Inits[I] : FlatAST::None);
+            Last = F.add(FlatAST::Define, 0, First, Count, loc(Node));
+        }
+
+        virtual void visit(Assignment &Node) override
+        {
+            uint32_t V = flatten(Node.getRight());
+            Last = F.add(FlatAST::Assign, 0, Node.getLeft()->getSym(), V, loc(Node));
+        }
+
+        virtual void visit(IF &Node) override
+        {
+            for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
+                flatten(*I);
+            Last = FlatAST::None;
+        }
+
+        virtual void visit(Loop &Node) override
+        {
+            F.add(FlatAST::LoopBegin, 0, 0, 0, loc(Node));
+            uint32_t C = flatten(Node.getExprs());
+            F.add(FlatAST::LoopTest, 0, C, 0, loc(Node));
+            flatten(Node.getIF());
+            F.add(FlatAST::LoopEnd, 0, 0, 0, loc(Node));
+            Last = FlatAST::None;
+        }
+
+        // one body per condition, plus a trailing else body if present
+        virtual void visit(Condition &Node) override
+        {
+            llvm::SmallVector<IF *> Bodies = Node.getAllAssignments();
+            F.add(FlatAST::CondBegin, 0, 0, 0, loc(Node));
+            size_t Idx = 0;
+            for (auto I = Node.exprs_begin(), E = Node.exprs_end(); I != E && Idx < Bodies.size(); ++I, ++Idx)
+            {
+                uint32_t C = flatten(*I);
+                F.add(FlatAST::CondTest, 0, C, 0, loc(Node));
+                flatten(Bodies[Idx]);
+                F.add(FlatAST::BranchEnd, 0, 0, 0, loc(Node));
+            }
+            if (Idx < Bodies.size())
+            {
+                F.add(FlatAST::CondElse, 0, 0, 0, loc(Node));
+                flatten(Bodies[Idx]);
+                F.add(FlatAST::BranchEnd, 0, 0, 0, loc(Node));
+            }
+            F.add(FlatAST::CondEnd, 0, 0, 0, loc(Node));
+            Last = FlatAST::None;
+        }
+    };
+}
+
+FlatAST::FlatAST(AST *Tree)
+{
+    FlatBuilder Builder(*this);
+    if (Tree)
+        Tree->accept(Builder);
+}
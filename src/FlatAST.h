@@ -0,0 +1,87 @@
+#ifndef FLATAST_H
+#define FLATAST_H
+
+#include "AST.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+
+// FlatAST is a compact alternative encoding of a Goal tree. Nodes live in
+// parallel arrays (kind, operator, two 32-bit operands, location) and
+// refer to their children by 32-bit index. The order is post-order, so
+// every operand comes before the node that uses it. Control flow is
+// bracketed by marker nodes, which turns Sema and CodeGen into single
+// forward scans.
+//
+//   Number      A = value
+//   Ident       A = symbol ID
+//   Binary      Op = BinaryOp::Operator, A/B = left/right operand
+//   Define      A = first index into Extra, B = number of variables;
+//               Extra[A, A+B) are their symbol IDs and Extra[A+B, A+2B)
+//               their initializers (None if absent)
+//   Assign      A = symbol ID of the target, B = value
+//   LoopBegin   starts a loopc; its condition follows
+//   LoopTest    A = condition; the body follows
+//   LoopEnd     closes the innermost loopc
+//   CondBegin   starts an if/elif/else chain
+//   CondTest    A = condition of the next branch; its body follows
+//   CondElse    the else body follows
+//   BranchEnd   closes the body of one branch
+//   CondEnd     closes the innermost chain
+class FlatAST
+{
+public:
+    enum Kind : uint8_t
+    {
+        Number,
+        Ident,
+        Binary,
+        Define,
+        Assign,
+        LoopBegin,
+        LoopTest,
+        LoopEnd,
+        CondBegin,
+        CondTest,
+        CondElse,
+        BranchEnd,
+        CondEnd
+    };
+
+    static const uint32_t None = ~0u;
+
+    llvm::SmallVector<Kind, 0> Kinds;
+    llvm::SmallVector<uint8_t, 0> Ops;
+    llvm::SmallVector<uint32_t, 0> A;
+    llvm::SmallVector<uint32_t, 0> B;
+    llvm::SmallVector<uint32_t, 0> Locs;
+    llvm::SmallVector<uint32_t, 0> Extra;
+
+    FlatAST() {}
+
+    // flattens Tree; statements keep the LocDelta of their StmtRange
+    explicit FlatAST(AST *Tree);
+
+    size_t size() const { return Kinds.size(); }
+
+    // First node of the expression rooted at Root: nodes are in post-order
+    // and not shared, so that is its leftmost leaf. A statement's names
+    // are resolved there, before the expressions it holds (see Sema).
+    uint32_t firstNode(uint32_t Root) const
+    {
+        while (Kinds[Root] == Binary)
+            Root = A[Root];
+        return Root;
+    }
+
+    uint32_t add(Kind K, uint8_t Op, uint32_t NodeA, uint32_t NodeB, uint32_t Loc)
+    {
+        Kinds.push_back(K);
+        Ops.push_back(Op);
+        A.push_back(NodeA);
+        B.push_back(NodeB);
+        Locs.push_back(Loc);
+        return uint32_t(Kinds.size() - 1);
+    }
+};
+
+#endif
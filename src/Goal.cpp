@@ -1,15 +1,82 @@
-#include "CodeGen.h"
-#include "Parser.h"
-#include "Sema.h"
+#include "Driver.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/InitLLVM.h"
-#include "llvm/Support/raw_ostream.h"
 
-// Define a command-line option for specifying the input expression.
+// Define a command-line option for specifying the input file ("-" reads stdin).
 static llvm::cl::opt<std::string>
-    Input(llvm::cl::Positional,
-          llvm::cl::desc("<input expression>"),
-          llvm::cl::init(""));
+    InputFilename(llvm::cl::Positional,
+                  llvm::cl::desc("<input file>"),
+                  llvm::cl::init("-"));
+
+// Lex the whole input into a compact token array before parsing.
+static llvm::cl::opt<bool>
+    PreLex("prelex",
+           llvm::cl::desc("Lex the whole input before parsing"),
+           llvm::cl::init(false));
+
+// Lex the input on several threads (implies -prelex).
+static llvm::cl::opt<unsigned>
+    LexThreads("lex-threads",
+               llvm::cl::desc("Number of threads used to pre-lex the input"),
+               llvm::cl::init(1));
+
+// Parse top-level statements on several threads (implies -prelex).
+static llvm::cl::opt<unsigned>
+    ParseThreads("parse-threads",
+                 llvm::cl::desc("Number of threads used to parse the input"),
+                 llvm::cl::init(1));
+
+// Check top-level statements on several threads.
+static llvm::cl::opt<unsigned>
+    SemaThreads("sema-threads",
+                llvm::cl::desc("Number of threads used for semantic analysis"),
+                llvm::cl::init(1));
+
+// Read the input in fixed-size chunks instead of loading it at once.
+static llvm::cl::opt<bool>
+    Stream("stream",
+           llvm::cl::desc("Lex the input in chunks with bounded memory"),
+           llvm::cl::init(false));
+
+// Bytes read at a time with -stream; small sizes split many tokens.
+static llvm::cl::opt<unsigned>
+    StreamChunkSize("stream-chunk-size",
+                    llvm::cl::desc("Bytes read at a time with -stream"),
+                    llvm::cl::init(64 * 1024), llvm::cl::Hidden);
+
+// Run Sema and CodeGen on the flat encoding of the tree.
+static llvm::cl::opt<bool>
+    Flat("flat",
+         llvm::cl::desc("Check and compile a flat, index-based copy of the AST"),
+         llvm::cl::init(false));
+
+// Keep parsed programs in a directory and reuse them for unchanged input.
+static llvm::cl::opt<std::string>
+    ASTCacheDir("ast-cache",
+                llvm::cl::desc("Cache parsed ASTs in <dir> (ignored with -stream)"),
+                llvm::cl::value_desc("dir"));
+
+// Build structurally identical expressions once and share them.
+static llvm::cl::opt<bool>
+    ShareExprs("share-exprs",
+               llvm::cl::desc("Hash-cons identical subexpressions into shared AST nodes "
+                              "(ignored with -sema-threads)"),
+               llvm::cl::init(false));
+
+// Parse with the LL(1) tables generated from Grammar.txt.
+static llvm::cl::opt<bool>
+    TableDriven("ll",
+                llvm::cl::desc("Use the table-driven LL(1) parser (ignored with -stream, "
+                               "-prelex and threads)"),
+                llvm::cl::init(false));
+
+// Replace expressions known at compile time by their values. Off by
+// default: it changes the IR goal prints, and -flat and -ast-cache then
+// need the tree Sema as well.
+static llvm::cl::opt<bool>
+    FoldConstants("fold-constants",
+                  llvm::cl::desc("Propagate and fold constants before code generation"),
+                  llvm::cl::init(false));
 
 // The main function of the program.
 int main(int argc, const char **argv)
@@ -20,34 +87,19 @@ int main(int argc, const char **argv)
     // Parse command-line options.
     llvm::cl::ParseCommandLineOptions(argc, argv, "Goal - the expression compiler\n");
 
-    // Create a lexer object and initialize it with the input expression.
-    Lexer Lex(Input);
-
-    // Create a parser object and initialize it with the lexer.
-    Parser Parser(Lex);
-
-    // Parse the input expression and generate an abstract syntax tree (AST).
-    AST *Tree = Parser.parse();
-
-    // Check if parsing was successful or if there were any syntax errors.
-    if (!Tree || Parser.hasError())
-    {
-        llvm::errs() << "Syntax errors occurred\n";
-        return 1;
-    }
-
-    // Perform semantic analysis on the AST.
-    Sema Semantic;
-    if (Semantic.semantic(Tree))
-    {
-        llvm::errs() << "Semantic errors occurred\n";
-        return 1;
-    }
-
-    // Generate code for the AST using a code generator.
-    CodeGen CodeGenerator;
-    CodeGenerator.compile(Tree);
+    DriverOptions Opts;
+    Opts.PreLex = PreLex;
+    Opts.LexThreads = LexThreads;
+    Opts.ParseThreads = ParseThreads;
+    Opts.SemaThreads = SemaThreads;
+    Opts.Stream = Stream;
+    Opts.StreamChunkSize = StreamChunkSize;
+    Opts.Flat = Flat;
+    Opts.ASTCacheDir = ASTCacheDir;
+    Opts.ShareExprs = ShareExprs;
+    Opts.TableDriven = TableDriven;
+    Opts.FoldConstants = FoldConstants;
 
-    // The program executed successfully.
-    return 0;
+    // Parse, check and compile the input; the module goes to stdout.
+    return compileProgram(InputFilename, Opts) ? 0 : 1;
 }
@@ -0,0 +1,72 @@
+#include "ProgramGenerator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+
+// goal_gen writes synthetic Goal programs of a given size and shape, used
+// to measure how each compiler phase scales.
+
+static llvm::cl::opt<std::string>
+    OutputFilename("o", llvm::cl::desc("Output file (default: stdout)"),
+                   llvm::cl::value_desc("filename"), llvm::cl::init("-"));
+
+static llvm::cl::opt<uint64_t>
+    Statements("statements", llvm::cl::desc("Top-level statements after the definitions"),
+               llvm::cl::init(1000));
+
+static llvm::cl::opt<unsigned>
+    Variables("vars", llvm::cl::desc("Number of int definitions"),
+              llvm::cl::init(16));
+
+static llvm::cl::opt<unsigned>
+    Depth("depth", llvm::cl::desc("Parenthesized nesting depth of expressions"),
+          llvm::cl::init(2));
+
+static llvm::cl::opt<unsigned>
+    Elifs("elifs", llvm::cl::desc("elif branches per condition"),
+          llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned>
+    BlockSize("block-size", llvm::cl::desc("Assignments per begin/end block"),
+              llvm::cl::init(2));
+
+static llvm::cl::opt<ProgramShape>
+    Shape("shape", llvm::cl::desc("Kind of top-level statements"),
+          llvm::cl::values(
+              clEnumValN(ProgramShape::Mixed, "mixed", "Assignments, conditions and loops"),
+              clEnumValN(ProgramShape::Assignments, "assign", "Only assignments"),
+              clEnumValN(ProgramShape::Conditions, "if", "Only if/elif/else chains"),
+              clEnumValN(ProgramShape::Loops, "loop", "Only loopc statements")),
+          llvm::cl::init(ProgramShape::Mixed));
+
+static llvm::cl::opt<unsigned>
+    Seed("seed", llvm::cl::desc("Random seed"), llvm::cl::init(1));
+
+int main(int argc, const char **argv)
+{
+    llvm::InitLLVM X(argc, argv);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "goal_gen - synthetic Goal programs\n");
+
+    std::error_code EC;
+    llvm::ToolOutputFile Out(OutputFilename, EC, llvm::sys::fs::OF_None);
+    if (EC)
+    {
+        llvm::errs() << "Error opening " << OutputFilename << ": " << EC.message() << "\n";
+        return 1;
+    }
+
+    GeneratorOptions Opts;
+    Opts.Statements = Statements;
+    Opts.Variables = Variables;
+    Opts.ExprDepth = Depth;
+    Opts.Elifs = Elifs;
+    Opts.BlockSize = BlockSize;
+    Opts.Shape = Shape;
+    Opts.Seed = Seed;
+    generateProgram(Opts, Out.os());
+
+    Out.keep();
+    return 0;
+}
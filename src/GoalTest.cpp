@@ -0,0 +1,1031 @@
+#include "ASTCache.h"
+#include "CodeGen.h"
+#include "ConstantFold.h"
+#include "Driver.h"
+#include "IncrementalParser.h"
+#include "LLParser.h"
+#include "Parser.h"
+#include "ProgramGenerator.h"
+#include "Sema.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/thread.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <csetjmp>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// goal_test compiles Goal programs along the paths of the driver, runs
+// the generated IR in a JIT and compares the values the programs write.
+// Each group of checks is registered with CTest; failures are printed and
+// make the exit status non-zero.
+
+static llvm::cl::opt<std::string>
+    Check("check",
+          llvm::cl::desc("Group of checks to run: roundtrip, precedence, deep, fold or "
+                         "incremental"),
+          llvm::cl::init("roundtrip"));
+
+// Generated programs compared across the modes, one per seed.
+static llvm::cl::opt<unsigned>
+    Seeds("seeds",
+          llvm::cl::desc("Generated programs per check"),
+          llvm::cl::init(10));
+
+// Nesting depth of the expressions in the deep check.
+static llvm::cl::opt<unsigned>
+    Depth("depth",
+          llvm::cl::desc("Nesting depth of the deep expressions"),
+          llvm::cl::init(50000));
+
+namespace
+{
+    // Driver options a program is compiled with
+    enum ModeFlags : unsigned
+    {
+        TableDriven = 1,  // -ll
+        Flat = 2,         // -flat
+        Cached = 4,       // -ast-cache, stored and loaded again
+        Shared = 8,       // -share-exprs
+        Folded = 16,      // -fold-constants
+        Threads = 32,     // -lex-threads, -parse-threads and -sema-threads
+        Streamed = 64,    // -stream
+        PreLexed = 128,   // -prelex
+        LexThreads = 256, // -lex-threads alone
+        SmallChunks = 512 // -stream, one byte at a time
+    };
+
+    struct Mode
+    {
+        const char *Name;
+        unsigned Flags;
+    };
+
+    const Mode Modes[] = {
+        {"default", 0},
+        {"-fold-constants", Folded},
+        {"-flat", Flat},
+        {"-flat -fold-constants", Flat | Folded},
+        {"-ll", TableDriven},
+        {"-share-exprs", Shared},
+        {"-ast-cache", Cached},
+        {"-ast-cache -fold-constants", Cached | Folded},
+        {"-lex-threads=4 -parse-threads=4 -sema-threads=4", Threads},
+        {"-stream", Streamed},
+        {"-stream -stream-chunk-size=1", Streamed | SmallChunks},
+        {"-prelex", PreLexed},
+        {"-lex-threads=4", LexThreads},
+    };
+
+    unsigned NumFailed = 0;
+    std::string WorkDir; // input files and the AST cache
+
+    void fail(const llvm::Twine &What)
+    {
+        llvm::errs() << "FAIL: " << What << "\n";
+        ++NumFailed;
+    }
+
+    bool failed(llvm::Error Err)
+    {
+        if (!Err)
+            return false;
+        llvm::logAllUnhandledErrors(std::move(Err), llvm::errs(), "goal_test: ");
+        return true;
+    }
+
+    // The options goal is run with in mode M
+    DriverOptions getOptions(const Mode &M)
+    {
+        DriverOptions Opts;
+        Opts.TableDriven = M.Flags & TableDriven;
+        Opts.Flat = M.Flags & Flat;
+        Opts.ShareExprs = M.Flags & Shared;
+        Opts.FoldConstants = M.Flags & Folded;
+        Opts.Stream = M.Flags & Streamed;
+        Opts.PreLex = M.Flags & PreLexed;
+        if (M.Flags & SmallChunks)
+            Opts.StreamChunkSize = 1; // every token is split across reads
+        if (M.Flags & Cached)
+            Opts.ASTCacheDir = WorkDir + "/cache";
+        if (M.Flags & (Threads | LexThreads))
+            Opts.LexThreads = 4;
+        if (M.Flags & Threads)
+            Opts.ParseThreads = Opts.SemaThreads = 4;
+        return Opts;
+    }
+
+    // Compiles Source with the driver in mode M and prints the module to
+    // IR. Returns false after a syntax or semantic error.
+    bool compile(llvm::StringRef Source, const Mode &M, std::string &IR)
+    {
+        // each thread of the deep check has an input file of its own
+        static std::atomic<unsigned> NumInputs(0);
+        std::string Input = WorkDir + "/input" + std::to_string(NumInputs++) + ".goal";
+        std::error_code EC;
+        {
+            llvm::raw_fd_ostream OS(Input, EC);
+            OS << Source;
+        }
+        if (EC)
+        {
+            fail("cannot write " + Input + ": " + EC.message());
+            return false;
+        }
+
+        // a cached program is compiled from the entry stored by the first
+        // run
+        DriverOptions Opts = getOptions(M);
+        llvm::raw_string_ostream OS(IR);
+        bool Compiled;
+        if (M.Flags & Cached)
+        {
+            std::string Discarded;
+            llvm::raw_string_ostream First(Discarded);
+            Compiled = compileProgram(Input, Opts, First);
+            if (Compiled)
+            {
+                ASTCache Cache(Opts.ASTCacheDir, Source,
+                               Opts.FoldConstants ? uint32_t(ASTCache::FoldedConstants) : uint32_t(0));
+                if (!llvm::sys::fs::exists(Cache.getPath()))
+                {
+                    fail("no cache entry at " + Cache.getPath());
+                    Compiled = false;
+                }
+                else
+                    Compiled = compileProgram(Input, Opts, OS);
+            }
+        }
+        else
+            Compiled = compileProgram(Input, Opts, OS);
+        OS.flush();
+        llvm::sys::fs::remove(Input);
+        return Compiled;
+    }
+
+    // Values written by the running program, up to OutputLimit of them
+    std::vector<int32_t> Output;
+    size_t OutputLimit;
+    std::jmp_buf Stop;
+
+    void write(int32_t Value)
+    {
+        Output.push_back(Value);
+        if (Output.size() >= OutputLimit)
+            std::longjmp(Stop, 1);
+    }
+
+    // Runs main() of the module in IR and collects what it writes. A
+    // program is stopped after Limit values, so one that does not end
+    // still yields a prefix of its output to compare.
+    bool run(const std::string &IR, std::vector<int32_t> &Values, size_t Limit = 10000)
+    {
+        auto Ctx = std::make_unique<llvm::LLVMContext>();
+        llvm::SMDiagnostic Diag;
+        std::unique_ptr<llvm::Module> Module =
+            llvm::parseIR(llvm::MemoryBufferRef(IR, "test"), Diag, *Ctx);
+        if (!Module)
+        {
+            Diag.print("goal_test", llvm::errs());
+            return false;
+        }
+
+        // the deep expressions make long blocks, which only the fast
+        // instruction selector handles in reasonable time
+        auto Target = llvm::orc::JITTargetMachineBuilder::detectHost();
+        if (failed(Target.takeError()))
+            return false;
+        Target->setCodeGenOptLevel(llvm::CodeGenOpt::None);
+        auto JIT = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*Target)).create();
+        if (failed(JIT.takeError()))
+            return false;
+        llvm::orc::MangleAndInterner Mangle((*JIT)->getExecutionSession(), (*JIT)->getDataLayout());
+        llvm::orc::SymbolMap Runtime;
+        Runtime[Mangle("goal_write")] = llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(&write), llvm::JITSymbolFlags::Exported);
+        if (failed((*JIT)->getMainJITDylib().define(llvm::orc::absoluteSymbols(Runtime))) ||
+            failed((*JIT)->addIRModule(llvm::orc::ThreadSafeModule(std::move(Module), std::move(Ctx)))))
+            return false;
+        auto Main = (*JIT)->lookup("main");
+        if (failed(Main.takeError()))
+            return false;
+
+        auto *MainFn = llvm::jitTargetAddressToPointer<int (*)(int, char **)>(Main->getAddress());
+        Output.clear();
+        OutputLimit = Limit;
+        if (!setjmp(Stop))
+            MainFn(0, nullptr);
+        Values = std::move(Output);
+        return true;
+    }
+
+    std::string toString(const std::vector<int32_t> &Values)
+    {
+        std::string S;
+        llvm::raw_string_ostream OS(S);
+        for (size_t I = 0; I < Values.size(); ++I)
+            OS << (I ? " " : "") << Values[I];
+        return OS.str();
+    }
+
+    // Compiles and runs Source in mode M; false after printing why not
+    bool compileAndRun(llvm::StringRef Name, llvm::StringRef Source, const Mode &M,
+                       std::vector<int32_t> &Values)
+    {
+        std::string IR;
+        if (!compile(Source, M, IR) || !run(IR, Values))
+        {
+            fail(Name + " [" + M.Name + "]: does not compile and run");
+            return false;
+        }
+        return true;
+    }
+
+    // Source in every mode must write Expected
+    void expectOutput(llvm::StringRef Name, llvm::StringRef Source,
+                      const std::vector<int32_t> &Expected)
+    {
+        for (const Mode &M : Modes)
+        {
+            std::vector<int32_t> Values;
+            if (compileAndRun(Name, Source, M, Values) && Values != Expected)
+                fail(Name + " [" + M.Name + "]: wrote " + toString(Values) + ", expected " +
+                     toString(Expected));
+        }
+    }
+
+    std::string generate(const GeneratorOptions &Opts)
+    {
+        std::string Source;
+        llvm::raw_string_ostream OS(Source);
+        generateProgram(Opts, OS);
+        return OS.str();
+    }
+
+    // Source must write the same in every mode as in the first one
+    void expectSameOutput(llvm::StringRef Name, llvm::StringRef Source)
+    {
+        std::vector<int32_t> Reference;
+        if (!compileAndRun(Name, Source, Modes[0], Reference))
+            return;
+        for (const Mode &M : llvm::makeArrayRef(Modes).drop_front())
+        {
+            std::vector<int32_t> Values;
+            if (compileAndRun(Name, Source, M, Values) && Values != Reference)
+                fail(Name + " [" + M.Name + "]: output differs from [" + Modes[0].Name + "]");
+        }
+    }
+
+    // Expressions ConstantFold replaces in Source; 0 if it does not pass
+    // Sema
+    unsigned countFolds(llvm::StringRef Source)
+    {
+        std::unique_ptr<llvm::MemoryBuffer> Buffer =
+            llvm::MemoryBuffer::getMemBufferCopy(Source, "test");
+        SymbolTable Symbols;
+        ASTContext Context;
+        Lexer Lex(Buffer->getBuffer(), &Symbols);
+        Parser P(Lex, Context);
+        AST *Tree = P.parse();
+        if (!Tree || P.hasError() || Sema().semantic(Tree))
+            return 0;
+        return ConstantFold().fold(Tree, Context);
+    }
+
+    // Source must write the same with and without folding, in each mode
+    // that folds
+    void expectSameFolded(llvm::StringRef Name, llvm::StringRef Source)
+    {
+        for (const Mode &Folding : Modes)
+        {
+            if (!(Folding.Flags & Folded))
+                continue;
+            const Mode *NoFolding = std::find_if(
+                std::begin(Modes), std::end(Modes),
+                [&](const Mode &M) { return M.Flags == (Folding.Flags & ~Folded); });
+            std::vector<int32_t> Reference, Values;
+            if (compileAndRun(Name, Source, *NoFolding, Reference) &&
+                compileAndRun(Name, Source, Folding, Values) && Values != Reference)
+                fail(Name + " [" + Folding.Name + "]: output differs from [" + NoFolding->Name +
+                     "]");
+        }
+    }
+
+    // Every statement form through every path of the driver
+    void checkRoundTrip()
+    {
+        expectOutput("statements",
+                     "int a, b = 7, 3;\n"
+                     "int c;\n"
+                     "c = a + b * 2;\n"
+                     "c = (a + b) * 2;\n"
+                     "c = a - b - 1;\n"
+                     "c = a / b;\n"
+                     "c = a % b;\n"
+                     "c = 2 ^ 3 ^ 2;\n"
+                     "c = 2 ^ b;\n"
+                     "c = b ^ 0;\n"
+                     "c = 3 ^ 20;\n"
+                     "c += 5;\n"
+                     "c = a;\n"
+                     "c *= 2;\n"
+                     "c -= 4;\n"
+                     "c /= 3;\n"
+                     "c %= 2;\n"
+                     "if c == 1: begin c = 100; end\n"
+                     "elif c > 1: begin c = 200; end\n"
+                     "else: begin c = 300; end;\n"
+                     "if a < b: begin c = 1; end\n"
+                     "elif a > b and b > 0 or c == 0: begin c = 2; end;\n"
+                     "loopc b > 0 and a > 0: begin a = a * 2; b -= 1; end;\n"
+                     "c = a;\n",
+                     {13, 20, 3, 2, 1, 512, 8, 1, -808182895, -808182890, 7, 14, 10, 3, 1, 100,
+                      2, 14, 2, 28, 1, 56, 0, 56});
+
+        expectOutput("values",
+                     "int x = 1;\n"
+                     "int y;\n"
+                     "loopc x < 100: begin x = x * 3; end;\n"
+                     "y = x + 1;\n"
+                     "if y > 200: begin x = 0; end;\n"
+                     "y = 10 / (x + 2);\n"
+                     "y = y ^ x;\n"
+                     "int z = y + x;\n"
+                     "z = z - 0 - 1;\n"
+                     "int m = 2147483647;\n"
+                     "m = m + 1;\n",
+                     {3, 9, 27, 81, 243, 244, 0, 5, 1, 0, -2147483647 - 1});
+
+        // An initializer may read every name of its Define: one whose
+        // initializer has not run yet is 0, and the flat modes must make
+        // the slots before lowering the first initializer
+        expectOutput("self initializer",
+                     "int a = a;\n"
+                     "a = a + 1;\n",
+                     {1});
+        expectOutput("initializer order",
+                     "int c;\n"
+                     "loopc c < 3: begin c += 1; end;\n"
+                     "int a, b = c, a;\n"
+                     "b = b + 1;\n",
+                     {1, 2, 3, 4});
+        expectOutput("later names",
+                     "int x, y, z = y + 1, x + z, x;\n"
+                     "z = z + y;\n",
+                     {2});
+
+        // the first is large enough for the threaded modes to split it
+        for (unsigned Seed = 1; Seed <= Seeds; ++Seed)
+        {
+            GeneratorOptions Opts;
+            Opts.Statements = Seed == 1 ? 2500 : 200;
+            Opts.Variables = 8;
+            Opts.Seed = Seed;
+            expectSameOutput("generated seed " + std::to_string(Seed), generate(Opts));
+        }
+    }
+
+    // An entry whose tree FlatAST(AST *) could not have built must be a
+    // miss, which recompiles the source, rather than reach Sema and CodeGen
+    void checkCacheEntries()
+    {
+        const char *Source = "int a = 1;\na = a + 2;\n";
+        SymbolTable Symbols;
+        uint32_t Sym = Symbols.intern("a");
+        FlatAST Good;
+        Good.add(FlatAST::Number, 0, 1, 0, 8);
+        Good.Extra = {Sym, 0};
+        Good.add(FlatAST::Define, 0, 0, 1, 0);
+        Good.add(FlatAST::Ident, 0, Sym, 0, 15);
+        Good.add(FlatAST::Number, 0, 2, 0, 19);
+        Good.add(FlatAST::Binary, BinaryOp::Plus, 2, 3, 17);
+        Good.add(FlatAST::Assign, 0, Sym, 4, 11);
+
+        struct Case
+        {
+            const char *Name;
+            void (*Corrupt)(FlatAST &);
+        };
+        const Case Cases[] = {
+            {"as it was built", [](FlatAST &) {}},
+            {"an operand that is a statement", [](FlatAST &F) { F.B[5] = 1; }},
+            {"a shared operand", [](FlatAST &F) { F.A[4] = 3; }},
+            {"swapped operands", [](FlatAST &F) { std::swap(F.A[4], F.B[4]); }},
+            {"an assignment operator", [](FlatAST &F) { F.Ops[4] = BinaryOp::plus_equal; }},
+            {"an unknown kind", [](FlatAST &F) { F.Kinds[3] = FlatAST::Kind(99); }},
+            {"an unused value", [](FlatAST &F) { F.add(FlatAST::Number, 0, 7, 0, 0); }},
+            {"an initializer after a name without one",
+             [](FlatAST &F)
+             {
+                 F.Extra = {0, 0, FlatAST::None, 0};
+                 F.B[1] = 2;
+             }},
+            {"an unclosed loopc",
+             [](FlatAST &F)
+             {
+                 F.add(FlatAST::LoopBegin, 0, 0, 0, 0);
+                 F.add(FlatAST::LoopTest, 0, F.add(FlatAST::Number, 0, 0, 0, 0), 0, 0);
+             }},
+            {"a branch outside an if", [](FlatAST &F) { F.add(FlatAST::BranchEnd, 0, 0, 0, 0); }},
+            {"a define in a loopc",
+             [](FlatAST &F)
+             {
+                 F = FlatAST();
+                 F.add(FlatAST::LoopBegin, 0, 0, 0, 0);
+                 F.add(FlatAST::LoopTest, 0, F.add(FlatAST::Number, 0, 0, 0, 0), 0, 0);
+                 F.Extra = {0, F.add(FlatAST::Number, 0, 3, 0, 0)};
+                 F.add(FlatAST::Define, 0, 0, 1, 0);
+                 F.add(FlatAST::LoopEnd, 0, 0, 0, 0);
+             }},
+        };
+
+        const Mode *CachedMode = std::find_if(std::begin(Modes), std::end(Modes),
+                                              [](const Mode &M) { return M.Flags == Cached; });
+        ASTCache Cache(WorkDir + "/cache", Source);
+        for (const Case &C : Cases)
+        {
+            FlatAST Stored = Good;
+            C.Corrupt(Stored);
+            bool Valid = &C == Cases;
+            FlatAST Loaded;
+            SymbolTable LoadedSymbols;
+            if (!Cache.store(Stored, Symbols) || Cache.load(Loaded, LoadedSymbols) != Valid)
+            {
+                fail(std::string("cache entry with ") + C.Name + (Valid ? " is not" : " is") +
+                     " loaded");
+                continue;
+            }
+            if (Valid)
+                continue;
+            std::vector<int32_t> Values;
+            if (compileAndRun(C.Name, Source, *CachedMode, Values) && Values != std::vector<int32_t>{3})
+                fail(std::string("cache entry with ") + C.Name + ": wrote " + toString(Values));
+        }
+    }
+
+    // Both parsers record the same statement ranges, which reparse() and
+    // the LocDelta of diagnostics rely on
+    void checkStatementRanges()
+    {
+        std::vector<std::string> Sources = {
+            "int a;\n  a = 1 ;if a > 0: begin a = 2; end\n"
+            "elif a < 0: begin a = 3; end;\tloopc a < 5: begin a += 1; end;  \n"};
+        GeneratorOptions Opts;
+        Opts.Statements = 300;
+        Opts.Variables = 8;
+        Sources.push_back(generate(Opts));
+
+        for (const std::string &Source : Sources)
+        {
+            std::unique_ptr<llvm::MemoryBuffer> Buffer =
+                llvm::MemoryBuffer::getMemBufferCopy(Source, "test");
+            SymbolTable Symbols, LLSymbols;
+            ASTContext Context, LLContext;
+            Lexer Lex(Buffer->getBuffer(), &Symbols), LLLex(Buffer->getBuffer(), &LLSymbols);
+            Parser P(Lex, Context);
+            LLParser LLP(LLLex, LLContext);
+            auto *Tree = llvm::dyn_cast_or_null<Goal>(P.parse());
+            auto *LLTree = llvm::dyn_cast_or_null<Goal>(LLP.parse());
+            if (!Tree || !LLTree || P.hasError() || LLP.hasError())
+            {
+                fail("statement ranges: does not parse");
+                continue;
+            }
+            llvm::ArrayRef<StmtRange> Ranges = Tree->getRanges(), LLRanges = LLTree->getRanges();
+            bool Same = Ranges.size() == LLRanges.size() &&
+                        LLRanges.size() == size_t(LLTree->end() - LLTree->begin());
+            for (size_t I = 0; Same && I < Ranges.size(); ++I)
+                Same = Ranges[I].Begin == LLRanges[I].Begin && Ranges[I].End == LLRanges[I].End &&
+                       Ranges[I].LocDelta == LLRanges[I].LocDelta;
+            if (!Same)
+                fail("statement ranges: -ll records " + std::to_string(LLRanges.size()) +
+                     " that differ from the " + std::to_string(Ranges.size()) + " of Parser");
+        }
+    }
+
+    // Precedence and associativity of the operators as Grammar.txt gives
+    // them. Operands are variables, so nothing is folded before CodeGen
+    // when folding is off.
+    void checkPrecedence()
+    {
+        struct Case
+        {
+            const char *Expr;
+            int32_t Value;
+        };
+        const Case Cases[] = {
+            {"two + three * four", 14},
+            {"two * three + four", 10},
+            {"ten - four - three", 3},
+            {"ten * ten / ten / five", 2},
+            {"ten + 7 % five * two", 14},
+            {"(two + three) * four", 20},
+            {"((two))", 2},
+            {"two ^ three ^ two", 512},
+            {"two ^ (one + one) ^ two", 16},
+            {"two * three ^ two", 18},
+            {"two ^ two * three", 12},
+            {"ten - two ^ three - one", 1},
+            {"0 - two ^ two", -4},
+            {"ten % four ^ two", 10},
+            {"(ten - four) / (five - three) ^ two", 1},
+        };
+        for (const Case &C : Cases)
+            expectOutput(C.Expr,
+                         std::string("int one, two, three, four, five, ten = 1, 2, 3, 4, 5, 10;\n"
+                                     "int v;\n"
+                                     "v = ") +
+                             C.Expr + ";\n",
+                         {C.Value});
+
+        // 'and' and 'or' bind equally tight and group to the left
+        expectOutput("and/or",
+                     "int v;\n"
+                     "if 1 > 2: begin v = 1; end\n"
+                     "elif 1 < 2 or 1 < 2 and 1 > 2: begin v = 2; end\n"
+                     "else: begin v = 3; end;\n"
+                     "loopc v < 5 and 1 > 2 or v < 4: begin v += 1; end;\n",
+                     {3, 4});
+    }
+
+    // Expressions nested far deeper than a recursive walk could follow on
+    // a small stack, through the front end of every mode. Only compiling
+    // runs on that stack; the JIT then runs the program as usual.
+    void checkDeepNesting()
+    {
+        const unsigned StackSize = 256 * 1024;
+        const unsigned N = Depth;
+        std::string Open(N, '('), Close(N, ')'), Right, Left = "a", Power = "a";
+        for (unsigned I = 0; I < N; ++I)
+        {
+            Right += "(a + ";
+            Left += " - a";
+            Power += " ^ 1";
+        }
+        Right += "a" + Close;
+
+        struct Case
+        {
+            const char *Name;
+            std::string Expr;
+            int32_t Value;
+        };
+        const Case Cases[] = {
+            {"parentheses", Open + "a" + Close, 2},
+            {"right-nested +", Right, int32_t(2 * (N + 1))},
+            {"left-nested -", Left, int32_t(2 - 2 * int64_t(N))},
+            {"right-associative ^", Power, 2},
+        };
+        for (const Case &C : Cases)
+        {
+            std::string Source = "int a = 2;\na = " + C.Expr + ";\n";
+            for (const Mode &M : Modes)
+            {
+                std::string IR;
+                bool Compiled = false;
+                llvm::thread Worker(llvm::Optional<unsigned>(StackSize),
+                                    [&] { Compiled = compile(Source, M, IR); });
+                Worker.join();
+                std::vector<int32_t> Values;
+                if (!Compiled || !run(IR, Values))
+                    fail(llvm::Twine(C.Name) + " [" + M.Name + "]: does not compile and run");
+                else if (Values != std::vector<int32_t>{C.Value})
+                    fail(llvm::Twine(C.Name) + " [" + M.Name + "]: wrote " + toString(Values) +
+                         ", expected " + llvm::Twine(C.Value));
+            }
+        }
+    }
+
+    // Folded programs must behave as the IR CodeGen emits for the source
+    void checkFolding()
+    {
+        // +, - and * wrap around, so the IR must not mark them nsw: an
+        // optimizer could then give an overflowing program another
+        // meaning unfolded than folded
+        const char *Wrap = "int m, t = 2147483647, 0;\n"
+                           "m = m * 2 + 3;\n"
+                           "m = m - 2147483647 - 3;\n"
+                           "if m + 1 > m: begin t = 1; end\n"
+                           "else: begin t = 2; end;\n";
+        expectOutput("wrap-around", Wrap, {1, 2147483647, 2});
+        for (const Mode &M : Modes)
+        {
+            std::string IR;
+            if (!compile(Wrap, M, IR))
+                fail(llvm::Twine("wrap-around [") + M.Name + "]: does not compile");
+            else if (llvm::StringRef(IR).contains(" nsw "))
+                fail(llvm::Twine("wrap-around [") + M.Name + "]: IR has nsw arithmetic");
+        }
+
+        // exponents <= 0 give 1, whatever the base
+        expectOutput("exponents",
+                     "int e = 0 - 3;\n"
+                     "int b, z = 5, 0;\n"
+                     "b = b ^ e;\n"
+                     "b = 2 ^ e + 7;\n"
+                     "z = z ^ 0;\n"
+                     "e = e ^ 2;\n",
+                     {1, 8, 1, 9});
+
+        // what the body assigns is unknown at the test, in the body and
+        // after the loop
+        expectOutput("loop",
+                     "int i, s = 0, 10;\n"
+                     "loopc i < 3: begin i += 1; s = s + i; end;\n"
+                     "s = s + i;\n",
+                     {1, 11, 2, 13, 3, 16, 19});
+
+        // after a condition only the values every path agrees on are known
+        expectOutput("condition",
+                     "int a, b = 1, 5;\n"
+                     "if b > 3: begin a = 2; end\n"
+                     "else: begin a = 2; b = 0; end;\n"
+                     "a = a + b;\n"
+                     "if b > 9: begin b = 1; end\n"
+                     "elif b < 0: begin b = 2; end;\n"
+                     "b = b + 1;\n",
+                     {2, 7, 6});
+
+        const ProgramShape Shapes[] = {ProgramShape::Mixed, ProgramShape::Assignments,
+                                       ProgramShape::Conditions, ProgramShape::Loops};
+        unsigned Folds = 0;
+        for (unsigned Seed = 1; Seed <= Seeds; ++Seed)
+        {
+            GeneratorOptions Opts;
+            Opts.Statements = 200;
+            Opts.Variables = 8;
+            Opts.Shape = Shapes[Seed % 4];
+            Opts.Seed = Seed;
+            std::string Source = generate(Opts);
+            Folds += countFolds(Source);
+            expectSameFolded("generated seed " + std::to_string(Seed), Source);
+        }
+        if (Seeds && !Folds)
+            fail("generated programs: nothing folded");
+    }
+
+    // The single edit that turns Before into After: what lies between
+    // their common prefix and their common suffix
+    TextEdit diff(llvm::StringRef Before, llvm::StringRef After)
+    {
+        size_t Prefix = 0;
+        while (Prefix < Before.size() && Prefix < After.size() && Before[Prefix] == After[Prefix])
+            ++Prefix;
+        size_t Suffix = 0;
+        while (Suffix < Before.size() - Prefix && Suffix < After.size() - Prefix &&
+               Before[Before.size() - 1 - Suffix] == After[After.size() - 1 - Suffix])
+            ++Suffix;
+        return {uint32_t(Prefix), uint32_t(Before.size() - Prefix - Suffix),
+                uint32_t(After.size() - Prefix - Suffix)};
+    }
+
+    // Tree of Buffer from Parser, or from LLParser if TableDriven; null
+    // after a syntax error
+    Goal *parseProgram(llvm::StringRef Buffer, bool TableDriven, ASTContext &Ctx,
+                       SymbolTable &Symbols)
+    {
+        Lexer Lex(Buffer, &Symbols);
+        if (TableDriven)
+        {
+            LLParser P(Lex, Ctx);
+            AST *Tree = P.parse();
+            return P.hasError() ? nullptr : llvm::dyn_cast_or_null<Goal>(Tree);
+        }
+        Parser P(Lex, Ctx);
+        AST *Tree = P.parse();
+        return P.hasError() ? nullptr : llvm::dyn_cast_or_null<Goal>(Tree);
+    }
+
+    // IR of Tree, or false after a semantic error
+    bool compileTree(Goal *Tree, std::string &IR)
+    {
+        if (Sema().semantic(Tree))
+            return false;
+        llvm::raw_string_ostream OS(IR);
+        CodeGen().compile(Tree, OS);
+        OS.flush();
+        return true;
+    }
+
+    // Reparsing Before, parsed by each parser, after the edit that makes
+    // After must give the statement ranges and the IR of a fresh parse
+    void expectSameReparsed(llvm::StringRef Name, llvm::StringRef Before, llvm::StringRef After)
+    {
+        std::unique_ptr<llvm::MemoryBuffer> Fresh =
+            llvm::MemoryBuffer::getMemBufferCopy(After, "after");
+        SymbolTable FreshSymbols;
+        ASTContext FreshContext;
+        Goal *Reference = parseProgram(Fresh->getBuffer(), false, FreshContext, FreshSymbols);
+        std::string ReferenceIR;
+        if (!Reference || !compileTree(Reference, ReferenceIR))
+        {
+            fail(Name + ": the edited program does not compile");
+            return;
+        }
+
+        for (bool TableDriven : {false, true})
+        {
+            std::string Where = (Name + (TableDriven ? " [-ll]" : "")).str();
+            std::unique_ptr<llvm::MemoryBuffer> Old =
+                llvm::MemoryBuffer::getMemBufferCopy(Before, "before");
+            std::unique_ptr<llvm::MemoryBuffer> New =
+                llvm::MemoryBuffer::getMemBufferCopy(After, "after");
+            SymbolTable Symbols;
+            ASTContext Context;
+            Goal *Tree = parseProgram(Old->getBuffer(), TableDriven, Context, Symbols);
+            std::string OldIR;
+            if (!Tree || !compileTree(Tree, OldIR))
+            {
+                fail(Where + ": the program does not compile");
+                continue;
+            }
+            bool HasError;
+            Goal *Reparsed = reparse(*Tree, diff(Before, After), New->getBuffer(), Context,
+                                     Symbols, nullptr, HasError);
+            if (!Reparsed || HasError)
+            {
+                fail(Where + ": reparse reports a syntax error");
+                continue;
+            }
+
+            llvm::ArrayRef<StmtRange> Ranges = Reparsed->getRanges();
+            llvm::ArrayRef<StmtRange> FreshRanges = Reference->getRanges();
+            bool SameRanges = Ranges.size() == FreshRanges.size();
+            for (size_t I = 0; SameRanges && I < Ranges.size(); ++I)
+                SameRanges = Ranges[I].Begin == FreshRanges[I].Begin &&
+                             Ranges[I].End == FreshRanges[I].End;
+            // every edit here leaves some statement untouched
+            llvm::SmallPtrSet<Expr *, 32> OldStmts(Tree->begin(), Tree->end());
+            bool Reused = std::any_of(Reparsed->begin(), Reparsed->end(),
+                                      [&](Expr *S) { return OldStmts.count(S); });
+            std::string IR;
+            if (!Reused)
+                fail(Where + ": no statement is reused");
+            else if (!SameRanges)
+                fail(Where + ": statement ranges differ from a fresh parse");
+            else if (!compileTree(Reparsed, IR) || IR != ReferenceIR)
+                fail(Where + ": IR differs from a fresh parse");
+        }
+    }
+
+    // reparse() after edits inside statements, across them and at their
+    // edges
+    void checkIncremental()
+    {
+        const char *Program = "int a, b;\n"
+                              "a = 1;\n"
+                              "b = a + 2;\n"
+                              "loopc a < 20: begin a = a * 2; b += 1; end;\n"
+                              "if b > 4: begin b = 0; end\n"
+                              "else: begin b = 1; end;\n"
+                              "a = a + b;\n";
+        auto edit = [&](llvm::StringRef Old, llvm::StringRef New)
+        {
+            std::string S = Program;
+            size_t At = S.find(Old.str());
+            assert(At != std::string::npos && "not in the program");
+            return S.replace(At, Old.size(), New.str());
+        };
+        expectSameReparsed("inside a statement", Program, edit("a + 2", "a * 3 + 2"));
+        expectSameReparsed("inside a block", Program, edit("b += 1", "b -= a"));
+        expectSameReparsed("across statements", Program, edit("1;\nb = a", "4;\nb = b"));
+        expectSameReparsed("splitting a statement", Program, edit("b = a + 2;", "b = a;\nb = b + 2;"));
+        expectSameReparsed("joining statements", Program, edit("a = 1;\nb = a + 2;", "b = 3;"));
+        expectSameReparsed("at the end of a statement", Program, edit("a = 1;", "a = 1; a = 7;"));
+        expectSameReparsed("at the start of a statement", Program, edit("\nb = a", "\nb = 5;b = a"));
+        expectSameReparsed("between statements", Program, edit("\nb = a", "\n\n  \nb = a"));
+        expectSameReparsed("removing a statement", Program, edit("a = 1;\n", ""));
+        expectSameReparsed("at the start", Program, edit("int a, b;", "int c = 3;\nint a, b;"));
+        expectSameReparsed("at the end", Program, std::string(Program) + "b = b * b;\n");
+
+        for (unsigned Seed = 1; Seed <= Seeds; ++Seed)
+        {
+            GeneratorOptions Opts;
+            Opts.Statements = 300;
+            Opts.Variables = 8;
+            Opts.Seed = Seed;
+            std::string Source = generate(Opts);
+            std::string Edited = Source;
+            size_t Plus = Edited.find('+', Edited.size() / 2);
+            if (Plus == std::string::npos)
+                continue;
+            Edited[Plus] = '-';
+            expectSameReparsed("generated seed " + std::to_string(Seed), Source, Edited);
+        }
+    }
+
+    // Checking Tree with IncrementalSema must report what checking it from
+    // scratch reports (Text is its source), and a clean tree must compile
+    // to the IR of a fresh parse with the resolutions it was left with
+    void expectSameChecked(llvm::StringRef Where, IncrementalSema &Incremental, Goal *Tree,
+                           llvm::StringRef Text)
+    {
+        std::string Diags;
+        llvm::raw_string_ostream OS(Diags);
+        LineTable Lines(Text);
+        bool Failed = Incremental.semantic(*Tree, &Lines, OS);
+        OS.flush();
+
+        std::unique_ptr<llvm::MemoryBuffer> Fresh =
+            llvm::MemoryBuffer::getMemBufferCopy(Text, "fresh");
+        SymbolTable FreshSymbols;
+        ASTContext FreshContext;
+        Goal *Reference = parseProgram(Fresh->getBuffer(), false, FreshContext, FreshSymbols);
+        if (!Reference)
+        {
+            fail(Where + ": syntax error");
+            return;
+        }
+        std::string FreshDiags;
+        llvm::raw_string_ostream FreshOS(FreshDiags);
+        LineTable FreshLines(Fresh->getBuffer());
+        bool FreshFailed = IncrementalSema().semantic(*Reference, &FreshLines, FreshOS);
+        FreshOS.flush();
+        if (Failed != FreshFailed || Diags != FreshDiags)
+        {
+            fail(Where + ": diagnostics differ from a fresh check:\n" + Diags + "instead of\n" +
+                 FreshDiags);
+            return;
+        }
+        if (Failed)
+            return;
+
+        std::string IR, ReferenceIR;
+        llvm::raw_string_ostream IROS(IR);
+        CodeGen().compile(Tree, IROS);
+        IROS.flush();
+        if (!compileTree(Reference, ReferenceIR) || IR != ReferenceIR)
+            fail(Where + ": IR differs from a fresh compile");
+    }
+
+    // IncrementalSema over a chain of edits, each reparsed from the
+    // version before, including ones that change what is declared
+    void checkIncrementalSema()
+    {
+        const char *Program = "int a, b;\n"
+                              "a = 1;\n"
+                              "b = a + 2;\n"
+                              "int c = a;\n"
+                              "loopc a < 20: begin a = a * 2; b += c; end;\n"
+                              "if b > 4: begin b = 0; end\n"
+                              "else: begin b = 1; end;\n"
+                              "a = a + b;\n"
+                              "c = a / b;\n";
+        struct Edit
+        {
+            const char *Name, *Old, *New;
+        };
+        const Edit Edits[] = {
+            {"a literal", "a + 2", "a + 3"},
+            {"an undeclared name", "int c = a;", "int c = d;"},
+            {"declaring it again", "int c = d;", "int c = a;"},
+            {"a declaration removed", "int a, b;", "int a;"},
+            {"a declaration added", "int a;", "int a, b;"},
+            {"a declaration renamed", "int c = a;", "int d = a;"},
+            {"renamed back", "int d = a;", "int c = a;"},
+            {"declared twice", "a = 1;", "int a = 1;"},
+            {"declared once", "int a = 1;", "a = 1;"},
+            {"identical statements", "a = a + b;", "a = a + b;\nint e;\na = a + b;\nint e;"},
+            {"the first of them removed", "a = a + b;\nint e;\n", ""},
+            // the edit is the space and the lines after it, so the second
+            // copy is reused
+            {"identical statements reading different declarations", "a = a + b;",
+             " a = a + b;\nint b;\n\na = a + b;"},
+            {"the first of them and the redeclaration removed", " a = a + b;\nint b;\n", ""},
+            {"everything shifted", "int a, b;", "\n\nint a, b;"},
+            {"a division by zero", "c = a / b;", "c = a / 0;"},
+            {"no division by zero", "c = a / 0;", "c = a / b;"},
+        };
+
+        for (bool TableDriven : {false, true})
+        {
+            std::vector<std::unique_ptr<llvm::MemoryBuffer>> Buffers;
+            Buffers.push_back(llvm::MemoryBuffer::getMemBufferCopy(Program, "v0"));
+            SymbolTable Symbols;
+            ASTContext Context;
+            Goal *Tree = parseProgram(Buffers.back()->getBuffer(), TableDriven, Context, Symbols);
+            if (!Tree)
+            {
+                fail("incremental sema: syntax error");
+                continue;
+            }
+            IncrementalSema Incremental;
+            std::string Text = Program;
+            expectSameChecked("incremental sema", Incremental, Tree, Text);
+
+            // the next version of Tree, with Old replaced by New
+            auto apply = [&](llvm::StringRef Where, llvm::StringRef Old, llvm::StringRef New)
+            {
+                std::string Next = Text;
+                size_t At = Next.find(Old.str());
+                assert(At != std::string::npos && "not in the program");
+                Next.replace(At, Old.size(), New.str());
+                Buffers.push_back(llvm::MemoryBuffer::getMemBufferCopy(Next, "next"));
+                bool HasError;
+                Goal *Reparsed = reparse(*Tree, diff(Text, Next), Buffers.back()->getBuffer(),
+                                         Context, Symbols, nullptr, HasError);
+                if (!Reparsed || HasError)
+                {
+                    fail(Where + ": reparse reports a syntax error");
+                    return false;
+                }
+                Tree = Reparsed;
+                Text = Next;
+                return true;
+            };
+
+            for (const Edit &E : Edits)
+            {
+                std::string Where = std::string("incremental sema, ") + E.Name +
+                                    (TableDriven ? " [-ll]" : "");
+                if (!apply(Where, E.Old, E.New))
+                    break;
+                expectSameChecked(Where, Incremental, Tree, Text);
+                if (&E == Edits && Incremental.getNumChecked() != 1)
+                    fail(Where + ": " + std::to_string(Incremental.getNumChecked()) +
+                         " statements checked, not 1");
+            }
+
+            // Declaration IDs of replaced Defines are handed out again
+            uint32_t IDs = 0;
+            for (unsigned Round = 0; Round != 40; ++Round)
+            {
+                bool Wider = Round % 2 == 0;
+                if (!apply("incremental sema, alternating declarations",
+                           Wider ? "int a, b;" : "int a, b, f;",
+                           Wider ? "int a, b, f;" : "int a, b;") ||
+                    !apply("incremental sema, alternating declarations",
+                           Wider ? "int c = a;" : "int c = a + 1;",
+                           Wider ? "int c = a + 1;" : "int c = a;"))
+                    break;
+                expectSameChecked("incremental sema, alternating declarations", Incremental, Tree,
+                                  Text);
+                if (Round == 1)
+                    IDs = Incremental.getNumDeclIDs();
+                else if (Round > 1 && Incremental.getNumDeclIDs() != IDs)
+                {
+                    fail("incremental sema: declaration IDs grow with every edit");
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// The main function of the tests.
+int main(int argc, const char **argv)
+{
+    llvm::InitLLVM X(argc, argv);
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::cl::ParseCommandLineOptions(argc, argv, "goal_test - end-to-end checks\n");
+
+    llvm::SmallString<128> Dir;
+    if (std::error_code EC = llvm::sys::fs::createUniqueDirectory("goal_test", Dir))
+    {
+        llvm::errs() << "Cannot create a work directory: " << EC.message() << "\n";
+        return 1;
+    }
+    WorkDir = std::string(Dir.str());
+
+    if (Check == "roundtrip")
+    {
+        checkRoundTrip();
+        checkCacheEntries();
+        checkStatementRanges();
+    }
+    else if (Check == "precedence")
+        checkPrecedence();
+    else if (Check == "deep")
+        checkDeepNesting();
+    else if (Check == "fold")
+        checkFolding();
+    else if (Check == "incremental")
+    {
+        checkIncremental();
+        checkIncrementalSema();
+    }
+    else
+        fail("unknown check " + Check);
+
+    llvm::sys::fs::remove_directories(WorkDir);
+    if (NumFailed)
+    {
+        llvm::errs() << NumFailed << " checks failed\n";
+        return 1;
+    }
+    llvm::outs() << Check << ": all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "IncrementalParser.h"
+#include "Parser.h"
+#include <algorithm>
+
+Goal *reparse(Goal &Old, const TextEdit &Edit, llvm::StringRef NewBuffer,
+              ASTContext &Ctx, SymbolTable &Symbols, const LineTable *Lines,
+              bool &HasError)
+{
+    HasError = false;
+    llvm::SmallVector<Expr *> OldStmts = Old.getExprs();
+    llvm::ArrayRef<StmtRange> OldRanges = Old.getRanges();
+    size_t N = OldRanges.size();
+    uint32_t EditEnd = Edit.Offset + Edit.Removed;
+    int64_t Delta = int64_t(Edit.Inserted) - int64_t(Edit.Removed);
+
+    // statements [First, Last) touch the edit; an edit right at a
+    // statement's edge (e.g. appending to it) counts as touching it
+    size_t First = std::lower_bound(OldRanges.begin(), OldRanges.end(), Edit.Offset,
+                                    [](const StmtRange &R, uint32_t Off)
+                                    { return R.End < Off; }) -
+                   OldRanges.begin();
+    size_t Last = std::upper_bound(OldRanges.begin(), OldRanges.end(), EditEnd,
+                                   [](uint32_t Off, const StmtRange &R)
+                                   { return Off < R.Begin; }) -
+                  OldRanges.begin();
+    Last = std::max(Last, First);
+
+    // relex from the end of the last untouched statement before the edit
+    // up to the start of the first untouched one after it, shifted into
+    // the new buffer
+    uint32_t RegionBegin = First > 0 ? OldRanges[First - 1].End : 0;
+
+    llvm::SmallVector<Expr *> Stmts(OldStmts.begin(), OldStmts.begin() + First);
+    llvm::SmallVector<StmtRange, 0> Ranges(OldRanges.begin(), OldRanges.begin() + First);
+
+    Lexer Lex(NewBuffer, RegionBegin, &Symbols);
+    Parser P(Lex, Ctx);
+    P.setLineTable(Lines);
+
+    // parse until the parser lands exactly on the shifted start of an old
+    // statement; an edit that merged statements simply consumes more
+    size_t Next = Last;
+    while (!P.atEnd())
+    {
+        while (Next < N && OldRanges[Next].Begin + Delta < P.getOffset())
+            ++Next;
+        if (Next < N && OldRanges[Next].Begin + Delta == P.getOffset())
+            break;
+        StmtRange R;
+        Expr *S = P.parseTopLevelStatement(R);
+        if (!S)
+            continue; // reported below, the region is still scanned for more errors
+        Stmts.push_back(S);
+        Ranges.push_back(R);
+    }
+    if (P.atEnd())
+        Next = N;
+    if (P.hasError())
+    {
+        P.printDiagnostics();
+        HasError = true;
+        return nullptr;
+    }
+
+    // reuse the rest, shifting only the recorded ranges
+    for (size_t I = Next; I < N; ++I)
+    {
+        StmtRange R = OldRanges[I];
+        R.Begin = uint32_t(R.Begin + Delta);
+        R.End = uint32_t(R.End + Delta);
+        R.LocDelta = int32_t(R.LocDelta + Delta);
+        Stmts.push_back(OldStmts[I]);
+        Ranges.push_back(R);
+    }
+    return Ctx.create<Goal>(Stmts, Ranges);
+}
@@ -0,0 +1,35 @@
+#ifndef INCREMENTALPARSER_H
+#define INCREMENTALPARSER_H
+
+#include "AST.h"
+#include "ASTContext.h"
+#include "LineTable.h"
+#include "SymbolTable.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+
+// A single replacement of Removed bytes at Offset by Inserted bytes.
+struct TextEdit
+{
+    uint32_t Offset;
+    uint32_t Removed;
+    uint32_t Inserted;
+};
+
+// Reparses only the top-level statements of Old touched by Edit and reuses
+// every other statement subtree as is, so the cost follows the size of
+// the edit rather than of the program. NewBuffer is the whole edited
+// input (NUL terminated). Old must have been parsed with statement ranges
+// (Parser::parse, Parser::parseParallel and LLParser::parse record them).
+//
+// Reused nodes still refer to the old buffer and the old ASTContext, so
+// both must outlive the new tree; passing the old context as Ctx is
+// fine. Statements after the edit keep their node locations and get a
+// StmtRange::LocDelta instead of being walked.
+//
+// Returns nullptr and sets HasError on a syntax error in the edited part.
+Goal *reparse(Goal &Old, const TextEdit &Edit, llvm::StringRef NewBuffer,
+              ASTContext &Ctx, SymbolTable &Symbols, const LineTable *Lines,
+              bool &HasError);
+
+#endif
@@ -0,0 +1,702 @@
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+
+// goal_llgen reads Grammar.txt and writes the LL(1) parse tables LLParser
+// runs on, as a header of constexpr arrays. The grammar is EBNF; groups,
+// repetitions and options are rewritten into helper nonterminals before
+// FIRST and FOLLOW are computed, and any LL(1) conflict is an error.
+
+static llvm::cl::opt<std::string>
+    InputFilename(llvm::cl::Positional, llvm::cl::desc("<grammar>"), llvm::cl::Required);
+
+static llvm::cl::opt<std::string>
+    OutputFilename("o", llvm::cl::desc("Output file (default: stdout)"),
+                   llvm::cl::value_desc("filename"), llvm::cl::init("-"));
+
+namespace
+{
+    struct Symbol
+    {
+        enum KindTy : uint8_t
+        {
+            Terminal,
+            NonTerminal,
+            Action
+        };
+        KindTy Kind;
+        unsigned Index;
+    };
+
+    using Sequence = std::vector<Symbol>;
+
+    struct TerminalInfo
+    {
+        std::string Spelling; // as written in the grammar, e.g. '+' or ID
+        std::string Kind;     // Token::TokenKind enumerator
+    };
+
+    struct NonTerminalInfo
+    {
+        std::string Name;
+        unsigned Line = 0;
+        bool Defined = false;
+        bool Recover = false;
+        std::vector<Sequence> Alts;
+    };
+
+    // a lexical item of a right-hand side
+    struct Item
+    {
+        enum KindTy : uint8_t
+        {
+            Name,   // nonterminal or named terminal
+            Quoted, // 'x'
+            Action, // @name
+            Punct   // ( ) | * + ?
+        };
+        KindTy Kind;
+        std::string Text;
+    };
+
+    class GrammarReader
+    {
+        std::vector<TerminalInfo> Terminals;
+        llvm::StringMap<unsigned> TerminalIndex;
+        std::vector<NonTerminalInfo> NonTerminals;
+        llvm::StringMap<unsigned> NonTerminalIndex;
+        std::vector<std::string> Actions;
+        llvm::StringMap<unsigned> ActionIndex;
+
+        // productions after EBNF expansion, as (nonterminal, right-hand side)
+        std::vector<std::pair<unsigned, Sequence>> Productions;
+
+        std::vector<bool> Nullable;
+        std::vector<llvm::BitVector> First, Follow;
+        std::vector<std::vector<int>> Table;
+
+        unsigned Line = 0;
+        bool HasError = false;
+
+        void error(unsigned L, const llvm::Twine &Msg)
+        {
+            llvm::errs() << InputFilename << ":" << L << ": " << Msg << "\n";
+            HasError = true;
+        }
+
+        static std::string stripComment(llvm::StringRef S);
+        bool lexRhs(llvm::StringRef S, std::vector<Item> &Items);
+        unsigned addHelper(unsigned Owner);
+        bool parseAlternatives(const std::vector<Item> &Items, size_t &Pos, unsigned Owner,
+                               std::vector<Sequence> &Alts);
+        bool parseSequence(const std::vector<Item> &Items, size_t &Pos, unsigned Owner, Sequence &Seq);
+        void readDirective(llvm::StringRef S);
+        void firstOf(const Sequence &Seq, size_t From, llvm::BitVector &Set, bool &SeqNullable);
+        std::string symbolName(Symbol S);
+
+    public:
+        bool read(llvm::StringRef Text);
+        bool build();
+        void emit(llvm::raw_ostream &OS);
+    };
+}
+
+std::string GrammarReader::stripComment(llvm::StringRef S)
+{
+    bool InQuote = false;
+    for (size_t I = 0; I < S.size(); ++I)
+    {
+        if (S[I] == '\'')
+            InQuote = !InQuote;
+        else if (S[I] == '#' && !InQuote)
+            return S.substr(0, I).rtrim().str();
+    }
+    return S.rtrim().str();
+}
+
+bool GrammarReader::lexRhs(llvm::StringRef S, std::vector<Item> &Items)
+{
+    size_t I = 0;
+    while (I < S.size())
+    {
+        char C = S[I];
+        if (C == ' ' || C == '\t')
+        {
+            ++I;
+            continue;
+        }
+        if (llvm::StringRef("()|*+?").contains(C))
+        {
+            Items.push_back({Item::Punct, std::string(1, C)});
+            ++I;
+            continue;
+        }
+        if (C == '\'')
+        {
+            size_t End = S.find('\'', I + 1);
+            if (End == llvm::StringRef::npos)
+            {
+                error(Line, "unterminated quoted terminal");
+                return false;
+            }
+            Items.push_back({Item::Quoted, S.slice(I, End + 1).str()});
+            I = End + 1;
+            continue;
+        }
+        bool IsAction = C == '@';
+        size_t Start = IsAction ? I + 1 : I;
+        size_t End = Start;
+        while (End < S.size() && (isalnum(S[End]) || S[End] == '_'))
+            ++End;
+        if (End == Start)
+        {
+            error(Line, llvm::Twine("unexpected character '") + llvm::Twine(C) + "'");
+            return false;
+        }
+        Items.push_back({IsAction ? Item::Action : Item::Name, S.slice(Start, End).str()});
+        I = End;
+    }
+    return true;
+}
+
+// a nonterminal for a group, repetition or option inside Owner's rule
+unsigned GrammarReader::addHelper(unsigned Owner)
+{
+    NonTerminalInfo Info;
+    Info.Name = NonTerminals[Owner].Name + "_" + std::to_string(NonTerminals.size());
+    Info.Line = NonTerminals[Owner].Line;
+    Info.Defined = true;
+    NonTerminals.push_back(Info);
+    return NonTerminals.size() - 1;
+}
+
+bool GrammarReader::parseAlternatives(const std::vector<Item> &Items, size_t &Pos, unsigned Owner,
+                                      std::vector<Sequence> &Alts)
+{
+    while (true)
+    {
+        Sequence Seq;
+        if (!parseSequence(Items, Pos, Owner, Seq))
+            return false;
+        Alts.push_back(Seq);
+        if (Pos < Items.size() && Items[Pos].Kind == Item::Punct && Items[Pos].Text == "|")
+        {
+            ++Pos;
+            continue;
+        }
+        return true;
+    }
+}
+
+bool GrammarReader::parseSequence(const std::vector<Item> &Items, size_t &Pos, unsigned Owner,
+                                  Sequence &Seq)
+{
+    while (Pos < Items.size())
+    {
+        const Item &It = Items[Pos];
+        if (It.Kind == Item::Punct && (It.Text == "|" || It.Text == ")"))
+            return true;
+        ++Pos;
+
+        // the alternatives of this atom, one single-symbol sequence unless
+        // it is a group
+        std::vector<Sequence> Atom;
+        switch (It.Kind)
+        {
+        case Item::Quoted:
+        case Item::Name:
+        {
+            auto T = TerminalIndex.find(It.Text);
+            if (T != TerminalIndex.end())
+            {
+                Atom.push_back({{Symbol::Terminal, T->second}});
+                break;
+            }
+            auto N = NonTerminalIndex.find(It.Text);
+            if (It.Kind == Item::Quoted || N == NonTerminalIndex.end())
+            {
+                error(Line, "undeclared symbol " + It.Text);
+                return false;
+            }
+            Atom.push_back({{Symbol::NonTerminal, N->second}});
+            break;
+        }
+        case Item::Action:
+        {
+            auto A = ActionIndex.insert({It.Text, unsigned(Actions.size())});
+            if (A.second)
+                Actions.push_back(It.Text);
+            Seq.push_back({Symbol::Action, A.first->second});
+            continue;
+        }
+        case Item::Punct:
+            if (It.Text != "(")
+            {
+                error(Line, "unexpected " + It.Text);
+                return false;
+            }
+            if (!parseAlternatives(Items, Pos, Owner, Atom))
+                return false;
+            if (Pos == Items.size() || Items[Pos].Text != ")")
+            {
+                error(Line, "missing )");
+                return false;
+            }
+            ++Pos;
+            break;
+        }
+
+        char Postfix = 0;
+        if (Pos < Items.size() && Items[Pos].Kind == Item::Punct &&
+            llvm::StringRef("*+?").contains(Items[Pos].Text[0]))
+            Postfix = Items[Pos++].Text[0];
+
+        if (!Postfix)
+        {
+            if (Atom.size() == 1)
+            {
+                Seq.insert(Seq.end(), Atom[0].begin(), Atom[0].end());
+                continue;
+            }
+            unsigned G = addHelper(Owner);
+            NonTerminals[G].Alts = Atom;
+            Seq.push_back({Symbol::NonTerminal, G});
+            continue;
+        }
+
+        // X* -> X X* | e,  X? -> X | e,  X+ -> X X*
+        unsigned H = addHelper(Owner);
+        Symbol HSym = {Symbol::NonTerminal, H};
+        for (Sequence &Alt : Atom)
+        {
+            Sequence S = Alt;
+            if (Postfix != '?')
+                S.push_back(HSym);
+            NonTerminals[H].Alts.push_back(S);
+        }
+        NonTerminals[H].Alts.push_back(Sequence());
+        if (Postfix == '+')
+        {
+            if (Atom.size() == 1)
+                Seq.insert(Seq.end(), Atom[0].begin(), Atom[0].end());
+            else
+            {
+                unsigned G = addHelper(Owner);
+                NonTerminals[G].Alts = Atom;
+                Seq.push_back({Symbol::NonTerminal, G});
+            }
+        }
+        Seq.push_back(HSym);
+    }
+    return true;
+}
+
+void GrammarReader::readDirective(llvm::StringRef S)
+{
+    llvm::SmallVector<llvm::StringRef, 8> Words;
+    S.split(Words, ' ', -1, /*KeepEmpty=*/false);
+    if (Words[0] == "%token")
+    {
+        if (Words.size() != 3)
+        {
+            error(Line, "expected %token <spelling> <token kind>");
+            return;
+        }
+        if (!TerminalIndex.insert({Words[1], unsigned(Terminals.size())}).second)
+        {
+            error(Line, "duplicate terminal " + Words[1]);
+            return;
+        }
+        Terminals.push_back({Words[1].str(), Words[2].str()});
+        return;
+    }
+    if (Words[0] == "%recover")
+    {
+        for (size_t I = 1; I < Words.size(); ++I)
+        {
+            auto N = NonTerminalIndex.find(Words[I]);
+            if (N == NonTerminalIndex.end())
+                error(Line, "undefined nonterminal " + Words[I]);
+            else
+                NonTerminals[N->second].Recover = true;
+        }
+        return;
+    }
+    error(Line, "unknown directive " + Words[0]);
+}
+
+bool GrammarReader::read(llvm::StringRef Text)
+{
+    // logical lines: a production continues on lines starting with '|'
+    std::vector<std::pair<unsigned, std::string>> Lines;
+    llvm::SmallVector<llvm::StringRef, 128> Raw;
+    Text.split(Raw, '\n');
+    for (size_t I = 0; I < Raw.size(); ++I)
+    {
+        std::string S = stripComment(Raw[I]);
+        llvm::StringRef Trimmed = llvm::StringRef(S).trim();
+        if (Trimmed.empty())
+            continue;
+        if (Trimmed.startswith("|") && !Lines.empty())
+            Lines.back().second += " " + Trimmed.str();
+        else
+            Lines.push_back({unsigned(I + 1), Trimmed.str()});
+    }
+
+    // all rule names first, so rules can refer to later ones
+    for (auto &L : Lines)
+    {
+        size_t Arrow = L.second.find("->");
+        if (L.second[0] == '%' || Arrow == std::string::npos)
+            continue;
+        std::string Name = llvm::StringRef(L.second).substr(0, Arrow).trim().str();
+        if (!NonTerminalIndex.insert({Name, unsigned(NonTerminals.size())}).second)
+        {
+            error(L.first, "duplicate rule " + Name);
+            continue;
+        }
+        NonTerminalInfo Info;
+        Info.Name = Name;
+        Info.Line = L.first;
+        NonTerminals.push_back(Info);
+    }
+
+    for (auto &L : Lines)
+    {
+        Line = L.first;
+        llvm::StringRef S = L.second;
+        if (S[0] == '%')
+        {
+            readDirective(S);
+            continue;
+        }
+        size_t Arrow = S.find("->");
+        if (Arrow == llvm::StringRef::npos)
+        {
+            error(Line, "expected a rule or a directive");
+            continue;
+        }
+        unsigned NT = NonTerminalIndex[S.substr(0, Arrow).trim()];
+        std::vector<Item> Items;
+        if (!lexRhs(S.substr(Arrow + 2), Items))
+            continue;
+        size_t Pos = 0;
+        std::vector<Sequence> Alts;
+        if (!parseAlternatives(Items, Pos, NT, Alts))
+            continue;
+        if (Pos != Items.size())
+        {
+            error(Line, "unbalanced )");
+            continue;
+        }
+        NonTerminals[NT].Alts = Alts;
+        NonTerminals[NT].Defined = true;
+    }
+
+    if (NonTerminals.empty())
+        error(1, "no rules");
+    return !HasError;
+}
+
+// FIRST of Seq[From..], and whether that suffix derives the empty string;
+// actions match nothing and are skipped
+void GrammarReader::firstOf(const Sequence &Seq, size_t From, llvm::BitVector &Set,
+                            bool &SeqNullable)
+{
+    for (size_t I = From; I < Seq.size(); ++I)
+    {
+        Symbol S = Seq[I];
+        if (S.Kind == Symbol::Action)
+            continue;
+        if (S.Kind == Symbol::Terminal)
+        {
+            Set.set(S.Index);
+            SeqNullable = false;
+            return;
+        }
+        Set |= First[S.Index];
+        if (!Nullable[S.Index])
+        {
+            SeqNullable = false;
+            return;
+        }
+    }
+    SeqNullable = true;
+}
+
+std::string GrammarReader::symbolName(Symbol S)
+{
+    switch (S.Kind)
+    {
+    case Symbol::Terminal:
+        return Terminals[S.Index].Spelling;
+    case Symbol::NonTerminal:
+        return NonTerminals[S.Index].Name;
+    case Symbol::Action:
+        return "@" + Actions[S.Index];
+    }
+    return "";
+}
+
+bool GrammarReader::build()
+{
+    size_t NumNT = NonTerminals.size(), NumT = Terminals.size();
+    for (unsigned N = 0; N < NumNT; ++N)
+        for (const Sequence &Alt : NonTerminals[N].Alts)
+            Productions.push_back({N, Alt});
+
+    Nullable.assign(NumNT, false);
+    First.assign(NumNT, llvm::BitVector(NumT));
+    Follow.assign(NumNT, llvm::BitVector(NumT));
+
+    for (bool Changed = true; Changed;)
+    {
+        Changed = false;
+        for (auto &P : Productions)
+        {
+            llvm::BitVector Set = First[P.first];
+            bool SeqNullable;
+            firstOf(P.second, 0, Set, SeqNullable);
+            if (Set != First[P.first] || (SeqNullable && !Nullable[P.first]))
+            {
+                First[P.first] = Set;
+                Nullable[P.first] = Nullable[P.first] || SeqNullable;
+                Changed = true;
+            }
+        }
+    }
+
+    for (bool Changed = true; Changed;)
+    {
+        Changed = false;
+        for (auto &P : Productions)
+            for (size_t I = 0; I < P.second.size(); ++I)
+            {
+                if (P.second[I].Kind != Symbol::NonTerminal)
+                    continue;
+                unsigned B = P.second[I].Index;
+                llvm::BitVector Set = Follow[B];
+                bool RestNullable;
+                firstOf(P.second, I + 1, Set, RestNullable);
+                if (RestNullable)
+                    Set |= Follow[P.first];
+                if (Set != Follow[B])
+                {
+                    Follow[B] = Set;
+                    Changed = true;
+                }
+            }
+    }
+
+    Table.assign(NumNT, std::vector<int>(NumT, -1));
+    for (size_t PI = 0; PI < Productions.size(); ++PI)
+    {
+        unsigned A = Productions[PI].first;
+        llvm::BitVector Set(NumT);
+        bool SeqNullable;
+        firstOf(Productions[PI].second, 0, Set, SeqNullable);
+        if (SeqNullable)
+            Set |= Follow[A];
+        for (unsigned T : Set.set_bits())
+        {
+            int &Entry = Table[A][T];
+            if (Entry >= 0)
+                error(NonTerminals[A].Line, "LL(1) conflict in " + NonTerminals[A].Name + " on " +
+                                                Terminals[T].Spelling);
+            else
+                Entry = int(PI);
+        }
+    }
+
+    for (unsigned N = 0; N < NumNT; ++N)
+        if (!NonTerminals[N].Defined)
+            error(NonTerminals[N].Line, "no rule for " + NonTerminals[N].Name);
+    return !HasError;
+}
+
+void GrammarReader::emit(llvm::raw_ostream &OS)
+{
+    OS << "// Generated by goal_llgen from Grammar.txt; do not edit.\n"
+          "//\n"
+          "// Parse stack symbols are Token kinds for terminals, NT_BASE + n for\n"
+          "// nonterminals and ACTION_BASE + n for semantic actions.\n\n"
+          "namespace llgrammar\n{\n";
+
+    OS << "    enum NonTerminal : uint16_t\n    {\n";
+    for (const NonTerminalInfo &N : NonTerminals)
+        OS << "        NT_" << N.Name << ",\n";
+    OS << "        NUM_NONTERMINALS\n    };\n\n";
+
+    OS << "    enum Action : uint16_t\n    {\n";
+    for (const std::string &A : Actions)
+        OS << "        A_" << A << ",\n";
+    OS << "        NUM_ACTIONS\n    };\n\n";
+
+    OS << "    constexpr uint16_t NT_BASE = Token::NUM_TOKENS;\n"
+          "    constexpr uint16_t ACTION_BASE = NT_BASE + NUM_NONTERMINALS;\n"
+          "    constexpr uint16_t NUM_SYMBOLS = ACTION_BASE + NUM_ACTIONS;\n\n";
+
+    // Each table entry is the whole leftmost derivation the driver would
+    // otherwise take one lookup at a time: a leading nonterminal is replaced
+    // by its production for the same look-ahead until a terminal, an action
+    // or a %recover nonterminal comes first.
+    std::vector<Sequence> Expansions;
+    std::vector<std::string> Comments;
+    std::vector<std::vector<int>> Entries(NonTerminals.size(), std::vector<int>(Terminals.size(), -1));
+    for (size_t N = 0; N < NonTerminals.size(); ++N)
+        for (size_t T = 0; T < Terminals.size(); ++T)
+        {
+            if (Table[N][T] < 0)
+                continue;
+            Sequence Seq = Productions[Table[N][T]].second;
+            // an LL(1) grammar has no left recursion, so this ends
+            for (size_t Steps = 0; Steps < NonTerminals.size() && !Seq.empty(); ++Steps)
+            {
+                Symbol Lead = Seq[0];
+                if (Lead.Kind != Symbol::NonTerminal || NonTerminals[Lead.Index].Recover ||
+                    Table[Lead.Index][T] < 0)
+                    break;
+                Sequence Next = Productions[Table[Lead.Index][T]].second;
+                Next.insert(Next.end(), Seq.begin() + 1, Seq.end());
+                Seq = Next;
+            }
+            Entries[N][T] = int(Expansions.size());
+            Expansions.push_back(Seq);
+            Comments.push_back(NonTerminals[N].Name + " on " + Terminals[T].Spelling);
+        }
+
+    // a nonterminal without an entry for the look-ahead still expands an
+    // alternative that starts with a %recover nonterminal, so the error is
+    // recovered there rather than further out
+    std::vector<int> ErrorEntries(NonTerminals.size(), -1);
+    for (size_t PI = 0; PI < Productions.size(); ++PI)
+    {
+        unsigned N = Productions[PI].first;
+        if (ErrorEntries[N] >= 0)
+            continue;
+        for (Symbol S : Productions[PI].second)
+        {
+            if (S.Kind == Symbol::Action)
+                continue;
+            if (S.Kind == Symbol::NonTerminal && NonTerminals[S.Index].Recover)
+            {
+                ErrorEntries[N] = int(Expansions.size());
+                Expansions.push_back(Productions[PI].second);
+                Comments.push_back(NonTerminals[N].Name + " on error");
+            }
+            break;
+        }
+    }
+
+    OS << "    struct Expansion\n    {\n        uint16_t Begin, Size;\n    };\n\n";
+
+    // the expansions back to back, one line each, reversed so they are
+    // pushed onto the parse stack with a single copy
+    OS << "    // symbols replacing a nonterminal, each reversed: the first is last\n"
+          "    constexpr uint16_t Rhs[] = {\n";
+    std::vector<std::pair<unsigned, unsigned>> Spans;
+    unsigned Begin = 0;
+    for (size_t EI = 0; EI < Expansions.size(); ++EI)
+    {
+        const Sequence &Seq = Expansions[EI];
+        OS << "        // " << EI << ": " << Comments[EI] << " ->";
+        for (Symbol S : Seq)
+            OS << " " << symbolName(S);
+        OS << "\n";
+        if (!Seq.empty())
+        {
+            OS << "       ";
+            for (auto I = Seq.rbegin(), E = Seq.rend(); I != E; ++I)
+            {
+                Symbol S = *I;
+                switch (S.Kind)
+                {
+                case Symbol::Terminal:
+                    OS << " Token::" << Terminals[S.Index].Kind << ",";
+                    break;
+                case Symbol::NonTerminal:
+                    OS << " NT_BASE + NT_" << NonTerminals[S.Index].Name << ",";
+                    break;
+                case Symbol::Action:
+                    OS << " ACTION_BASE + A_" << Actions[S.Index] << ",";
+                    break;
+                }
+            }
+            OS << "\n";
+        }
+        Spans.push_back({Begin, unsigned(Seq.size())});
+        Begin += Seq.size();
+    }
+    OS << "    };\n\n";
+
+    OS << "    constexpr Expansion Expansions[] = {\n";
+    for (size_t EI = 0; EI < Spans.size(); ++EI)
+        OS << "        {" << Spans[EI].first << ", " << Spans[EI].second << "},\n";
+    OS << "    };\n\n";
+
+    OS << "    // nonterminals a syntax error is recovered at\n"
+          "    constexpr bool Recovers[NUM_NONTERMINALS] = {\n";
+    for (const NonTerminalInfo &N : NonTerminals)
+        OS << "        " << (N.Recover ? "true" : "false") << ", // " << N.Name << "\n";
+    OS << "    };\n\n";
+
+    OS << "    // expansion on an unexpected look-ahead, -1 if none\n"
+          "    constexpr int16_t ErrorExpansions[NUM_NONTERMINALS] = {\n";
+    for (size_t N = 0; N < NonTerminals.size(); ++N)
+        OS << "        " << ErrorEntries[N] << ", // " << NonTerminals[N].Name << "\n";
+    OS << "    };\n\n";
+
+    OS << "    // expansion of a nonterminal on a look-ahead, -1 if none\n"
+          "    struct ParseTable\n    {\n"
+          "        int16_t Entry[NUM_NONTERMINALS][Token::NUM_TOKENS];\n    };\n\n"
+          "    constexpr ParseTable makeParseTable()\n    {\n"
+          "        ParseTable T{};\n"
+          "        for (unsigned N = 0; N < NUM_NONTERMINALS; ++N)\n"
+          "            for (unsigned K = 0; K < Token::NUM_TOKENS; ++K)\n"
+          "                T.Entry[N][K] = -1;\n";
+    for (size_t N = 0; N < NonTerminals.size(); ++N)
+        for (size_t T = 0; T < Terminals.size(); ++T)
+            if (Entries[N][T] >= 0)
+                OS << "        T.Entry[NT_" << NonTerminals[N].Name << "][Token::" << Terminals[T].Kind
+                   << "] = " << Entries[N][T] << ";\n";
+    OS << "        return T;\n    }\n\n"
+          "    constexpr ParseTable Table = makeParseTable();\n"
+          "}\n";
+}
+
+int main(int argc, const char **argv)
+{
+    llvm::InitLLVM X(argc, argv);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "goal_llgen - LL(1) tables from Grammar.txt\n");
+
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileOrErr =
+        llvm::MemoryBuffer::getFile(InputFilename);
+    if (std::error_code BufferError = FileOrErr.getError())
+    {
+        llvm::errs() << "Error reading " << InputFilename << ": " << BufferError.message() << "\n";
+        return 1;
+    }
+
+    GrammarReader Reader;
+    if (!Reader.read((*FileOrErr)->getBuffer()) || !Reader.build())
+        return 1;
+
+    std::error_code EC;
+    llvm::ToolOutputFile Out(OutputFilename, EC, llvm::sys::fs::OF_None);
+    if (EC)
+    {
+        llvm::errs() << "Error opening " << OutputFilename << ": " << EC.message() << "\n";
+        return 1;
+    }
+    Reader.emit(Out.os());
+    Out.keep();
+    return 0;
+}
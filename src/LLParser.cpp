@@ -0,0 +1,287 @@
+#include "LLParser.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "GoalGrammar.inc"
+
+using namespace llgrammar;
+
+namespace
+{
+    // parse stack symbol below the expansion of a %recover nonterminal;
+    // reaching it means the nonterminal was parsed without an error
+    constexpr uint16_t END_RECOVERY = NUM_SYMBOLS;
+
+    BinaryOp::Operator getOperator(Token::TokenKind Kind)
+    {
+        switch (Kind)
+        {
+        case Token::plus: case Token::plus_equal: return BinaryOp::Plus;
+        case Token::minus: case Token::minus_equal: return BinaryOp::Minus;
+        case Token::mul: case Token::mul_equal: return BinaryOp::Mul;
+        case Token::slash: case Token::slash_equal: return BinaryOp::Div;
+        case Token::mod: case Token::mod_equal: return BinaryOp::mod;
+        case Token::power: return BinaryOp::power;
+        case Token::is_equal: return BinaryOp::is_equal;
+        case Token::not_equal: return BinaryOp::not_equal;
+        case Token::gt: return BinaryOp::gt;
+        case Token::gte: return BinaryOp::gte;
+        case Token::lt: return BinaryOp::lt;
+        case Token::lte: return BinaryOp::lte;
+        case Token::AND: return BinaryOp::AND;
+        default: return BinaryOp::OR;
+        }
+    }
+}
+
+AST *LLParser::parse()
+{
+    Stack.push_back(NT_BASE + NT_Goal);
+    while (!Stack.empty())
+    {
+        uint16_t X = Stack.pop_back_val();
+        if (X < NT_BASE)
+        {
+            if (Tok.getKind() != X)
+            {
+                error(X);
+                continue;
+            }
+            Prev = Tok;
+            Lex.next(Tok);
+            continue;
+        }
+        if (X == END_RECOVERY)
+        {
+            Recovery.pop_back();
+            continue;
+        }
+        if (X >= ACTION_BASE)
+        {
+            act(X - ACTION_BASE);
+            continue;
+        }
+
+        unsigned NT = X - NT_BASE;
+        int16_t P = Table.Entry[NT][Tok.getKind()];
+        if (P < 0 && !Tok.is(Token::eoi))
+            P = ErrorExpansions[NT];
+        if (Recovers[NT])
+            Recovery.push_back({Stack.size(), Values.size(), Toks.size(), Marks.size()});
+        if (P < 0)
+        {
+            error(X);
+            continue;
+        }
+        if (Recovers[NT])
+            Stack.push_back(END_RECOVERY);
+        // the expansion was chosen on Tok, so a leading terminal is matched
+        // right away instead of going through the stack
+        const Expansion &Exp = Expansions[P];
+        const uint16_t *Begin = Rhs + Exp.Begin, *End = Begin + Exp.Size;
+        if (Begin != End && End[-1] < NT_BASE)
+        {
+            --End;
+            Prev = Tok;
+            Lex.next(Tok);
+        }
+        Stack.append(Begin, End);
+    }
+    return Result;
+}
+
+// Reports the look-ahead as unexpected where Symbol was to be matched. The
+// innermost %recover nonterminal being parsed, which may be Symbol itself,
+// is abandoned: the stacks go back to where it started, its value is null,
+// and the input is skipped like Parser::recover does. Outside any of them
+// the input is skipped and Symbol is tried again.
+void LLParser::error(uint16_t Symbol)
+{
+    printLoc(llvm::errs(), Lines, Tok.getOffset()) << "Unexpected: " << Tok.getText() << "\n";
+    HasError = true;
+    if (Recovery.empty())
+    {
+        Stack.push_back(Symbol);
+        skip(/*InBlock=*/false);
+        StmtBegin = Tok.getOffset(); // the skipped input starts no statement
+        return;
+    }
+    RecoveryPoint R = Recovery.pop_back_val();
+    Stack.resize(R.Stack);
+    Values.resize(R.Values);
+    Toks.resize(R.Toks);
+    Marks.resize(R.Marks);
+    Values.push_back(nullptr);
+    // a statement in a block is nested in a top-level one
+    skip(/*InBlock=*/!Recovery.empty());
+}
+
+// skips to just past the next ';' outside nested begin/end blocks, or to
+// an 'end' without a 'begin', which is left for the block to match unless
+// it is stray at top level
+void LLParser::skip(bool InBlock)
+{
+    int Depth = 0;
+    while (!Tok.is(Token::eoi))
+    {
+        if (Tok.is(Token::begin))
+            ++Depth;
+        else if (Tok.is(Token::end) && Depth == 0)
+        {
+            if (!InBlock)
+                Lex.next(Tok);
+            return;
+        }
+        else if (Tok.is(Token::end))
+            --Depth;
+        else if (Tok.is(Token::semicolon) && Depth == 0)
+        {
+            Lex.next(Tok);
+            return;
+        }
+        Lex.next(Tok);
+    }
+}
+
+void LLParser::act(unsigned A)
+{
+    switch (Action(A))
+    {
+    case A_final:
+        // literals are int; a larger one is reported as in Parser
+        if (Prev.is(Token::number))
+        {
+            int Value;
+            if (Prev.getText().getAsInteger(10, Value))
+            {
+                printLoc(llvm::errs(), Lines, Prev.getOffset())
+                    << "Integer literal out of range: " << Prev.getText() << "\n";
+                HasError = true;
+            }
+        }
+        Values.push_back(Ctx.getFinal(Prev.is(Token::id) ? Final::Id : Final::Number, Prev.getText(),
+                                      Prev.getSym(), Prev.getOffset()));
+        break;
+
+    case A_target:
+        Values.push_back(Ctx.getFinal(Final::Id, Prev.getText(), Prev.getSym(), Prev.getOffset()));
+        Toks.push_back(Prev);
+        break;
+
+    case A_op:
+    case A_var:
+        Toks.push_back(Prev);
+        break;
+
+    case A_mark:
+        Marks.push_back({Values.size(), Toks.size(), Prev.getOffset()});
+        break;
+
+    case A_binary:
+    {
+        Token Op = Toks.pop_back_val();
+        Expr *Right = popValue();
+        Expr *Left = popValue();
+        Values.push_back(Ctx.getBinaryOp(getOperator(Op.getKind()), Left, Right, Op.getOffset()));
+        break;
+    }
+
+    // a compound operator such as '+=' is stored as a plain assignment of
+    // the corresponding BinaryOp, as Parser does
+    case A_assign:
+    {
+        Token Op = Toks.pop_back_val();
+        Token Target = Toks.pop_back_val();
+        Expr *E = popValue();
+        Final *F = llvm::cast<Final>(popValue());
+        if (!Op.is(Token::equal))
+            E = Ctx.getBinaryOp(getOperator(Op.getKind()), F, E, Op.getOffset());
+        Expr *Assign = Ctx.create<Assignment>(F, E);
+        Assign->setLoc(Target.getOffset());
+        Values.push_back(Assign);
+        break;
+    }
+
+    case A_define:
+    {
+        Mark M = Marks.pop_back_val();
+        llvm::SmallVector<llvm::StringRef, 8> Vars;
+        llvm::SmallVector<uint32_t, 8> Syms;
+        for (size_t I = M.Toks; I < Toks.size(); ++I)
+        {
+            Vars.push_back(Toks[I].getText());
+            Syms.push_back(Toks[I].getSym());
+        }
+        llvm::SmallVector<Expr *> Exprs(Values.begin() + M.Values, Values.end());
+        Toks.resize(M.Toks);
+        Values.resize(M.Values);
+        Expr *D = Ctx.create<Define>(Vars, Syms, Exprs);
+        D->setLoc(M.Loc);
+        Values.push_back(D);
+        break;
+    }
+
+    // assignments that had a syntax error left a null value
+    case A_block:
+    {
+        Mark M = Marks.pop_back_val();
+        llvm::SmallVector<Expr *> Assigns;
+        for (size_t I = M.Values; I < Values.size(); ++I)
+            if (Values[I])
+                Assigns.push_back(Values[I]);
+        Values.resize(M.Values);
+        Values.push_back(Ctx.create<IF>(Assigns));
+        break;
+    }
+
+    // the values alternate condition, block, and end with the else block
+    // if there is one
+    case A_condition:
+    {
+        Mark M = Marks.pop_back_val();
+        llvm::SmallVector<Expr *> Conds;
+        llvm::SmallVector<IF *> Blocks;
+        size_t I = M.Values;
+        for (; I + 1 < Values.size(); I += 2)
+        {
+            Conds.push_back(Values[I]);
+            Blocks.push_back(llvm::cast<IF>(Values[I + 1]));
+        }
+        if (I < Values.size())
+            Blocks.push_back(llvm::cast<IF>(Values[I]));
+        Values.resize(M.Values);
+        Expr *Cond = Ctx.create<Condition>(Conds, Blocks);
+        Cond->setLoc(M.Loc);
+        Values.push_back(Cond);
+        break;
+    }
+
+    case A_loop:
+    {
+        Mark M = Marks.pop_back_val();
+        IF *Body = llvm::cast<IF>(popValue());
+        Expr *C = popValue();
+        Expr *L = Ctx.create<Loop>(C, Body);
+        L->setLoc(M.Loc);
+        Values.push_back(L);
+        break;
+    }
+
+    // the statement ends with Prev, and the next one starts at Tok
+    case A_stmt:
+        if (Expr *S = popValue())
+        {
+            Stmts.push_back(S);
+            Ranges.push_back({StmtBegin, Prev.getOffset() + uint32_t(Prev.getText().size()), 0, 0});
+        }
+        StmtBegin = Tok.getOffset();
+        break;
+
+    case A_goal:
+        Result = Ctx.create<Goal>(Stmts, Ranges);
+        break;
+
+    case NUM_ACTIONS:
+        break;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef LLPARSER_H
+#define LLPARSER_H
+
+#include "AST.h"
+#include "ASTContext.h"
+#include "Lexer.h"
+#include "LineTable.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+
+// LLParser parses the language of Parser with the LL(1) tables goal_llgen
+// generates from Grammar.txt: a single loop over an explicit parse stack
+// instead of recursive descent, so the parser cannot drift from the
+// grammar. The tree is built by the @actions of the grammar, on a stack
+// of values.
+class LLParser
+{
+    // where to unwind to when a syntax error occurs below a %recover
+    // nonterminal; sizes of the stacks when it was expanded
+    struct RecoveryPoint
+    {
+        size_t Stack, Values, Toks, Marks;
+    };
+
+    // start of a list of values and tokens, set by @mark
+    struct Mark
+    {
+        size_t Values, Toks;
+        uint32_t Loc; // of the keyword before @mark
+    };
+
+    Lexer &Lex;
+    ASTContext &Ctx;
+    Token Tok;  // look-ahead
+    Token Prev; // last matched terminal, read by the actions
+    bool HasError = false;
+    const LineTable *Lines = nullptr;
+
+    llvm::SmallVector<uint16_t, 64> Stack;  // grammar symbols still to match
+    llvm::SmallVector<Expr *, 64> Values;   // built subtrees
+    llvm::SmallVector<Token, 32> Toks;      // matched tokens kept by actions
+    llvm::SmallVector<Mark, 16> Marks;
+    llvm::SmallVector<RecoveryPoint, 4> Recovery;
+    llvm::SmallVector<Expr *> Stmts;        // completed top-level statements
+    llvm::SmallVector<StmtRange, 0> Ranges; // one per statement in Stmts
+    uint32_t StmtBegin = 0;                 // offset of the statement being parsed
+    AST *Result = nullptr;
+
+    void act(unsigned Action);
+    void error(uint16_t Symbol);
+    void skip(bool InBlock);
+
+    Expr *popValue() { return Values.pop_back_val(); }
+
+public:
+    // retrieves the first token
+    LLParser(Lexer &Lex, ASTContext &Ctx) : Lex(Lex), Ctx(Ctx)
+    {
+        Lex.next(Tok);
+        StmtBegin = Tok.getOffset();
+    }
+
+    // report diagnostics as line:col instead of raw offsets
+    void setLineTable(const LineTable *L) { Lines = L; }
+
+    bool hasError() { return HasError; }
+
+    // parses the whole input; statements with syntax errors are skipped
+    // and every error is reported. Statement ranges are recorded as
+    // Parser::parse does, so the tree can be passed to reparse().
+    AST *parse();
+};
+
+#endif
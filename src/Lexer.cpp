@@ -1,4 +1,10 @@
 #include "Lexer.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define GOAL_LEXER_SIMD 1
+#include <immintrin.h>
+#endif
 
 // classifying characters
 namespace charinfo
@@ -22,60 +28,196 @@ namespace charinfo
 
     LLVM_READNONE inline bool isDoubleOperation(char c)
     {
-        return c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '!' || c == '<' || c == '>';
+        return c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '!' || c == '<' || c == '>' || c == '=';
     }
 }
 
-void Lexer::next(Token &token)
+// scanning runs of one character class, 16 (SSE2) or 32 (AVX2) bytes at a
+// time while enough input is left and byte by byte for the tail. Every
+// scanner stops at the terminating NUL since it belongs to no class.
+namespace scan
+{
+    enum CharClass
+    {
+        Whitespace,
+        Letter,
+        Digit
+    };
+
+    template <CharClass CC>
+    LLVM_READNONE inline bool matches(char c)
+    {
+        return CC == Whitespace ? charinfo::isWhitespace(c)
+                                : (CC == Letter ? charinfo::isLetter(c) : charinfo::isDigit(c));
+    }
+
+    template <CharClass CC>
+    inline const char *scanScalar(const char *Ptr)
+    {
+        while (matches<CC>(*Ptr))
+            ++Ptr;
+        return Ptr;
+    }
+
+#ifdef GOAL_LEXER_SIMD
+    // bytes b with (unsigned)(b - Lo) <= Count
+    inline __m128i inRange16(__m128i V, char Lo, char Count)
+    {
+        __m128i D = _mm_sub_epi8(V, _mm_set1_epi8(Lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(D, _mm_set1_epi8(Count)), D);
+    }
+
+    template <CharClass CC>
+    inline __m128i classMask16(__m128i V)
+    {
+        if (CC == Whitespace) // ' ' and '\t' .. '\r'
+            return _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8(' ')),
+                                inRange16(V, '\t', 4));
+        if (CC == Letter) // fold to lower case, then 'a' .. 'z'
+            return inRange16(_mm_or_si128(V, _mm_set1_epi8(0x20)), 'a', 25);
+        return inRange16(V, '0', 9);
+    }
+
+    template <CharClass CC>
+    const char *scanSSE2(const char *Ptr, const char *End)
+    {
+        while (End - Ptr >= 16)
+        {
+            __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Ptr));
+            unsigned Miss = ~unsigned(_mm_movemask_epi8(classMask16<CC>(V))) & 0xFFFFu;
+            if (Miss)
+                return Ptr + __builtin_ctz(Miss);
+            Ptr += 16;
+        }
+        return scanScalar<CC>(Ptr);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i inRange32(__m256i V, char Lo, char Count)
+    {
+        __m256i D = _mm256_sub_epi8(V, _mm256_set1_epi8(Lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(D, _mm256_set1_epi8(Count)), D);
+    }
+
+    template <CharClass CC>
+    __attribute__((target("avx2"))) inline __m256i classMask32(__m256i V)
+    {
+        if (CC == Whitespace)
+            return _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8(' ')),
+                                   inRange32(V, '\t', 4));
+        if (CC == Letter)
+            return inRange32(_mm256_or_si256(V, _mm256_set1_epi8(0x20)), 'a', 25);
+        return inRange32(V, '0', 9);
+    }
+
+    template <CharClass CC>
+    __attribute__((target("avx2"))) const char *scanAVX2(const char *Ptr, const char *End)
+    {
+        while (End - Ptr >= 32)
+        {
+            __m256i V = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(Ptr));
+            unsigned Miss = ~unsigned(_mm256_movemask_epi8(classMask32<CC>(V)));
+            if (Miss)
+                return Ptr + __builtin_ctz(Miss);
+            Ptr += 32;
+        }
+        return scanSSE2<CC>(Ptr, End);
+    }
+
+    // selected once; the branch below is perfectly predicted afterwards
+    static const bool HasAVX2 = __builtin_cpu_supports("avx2");
+#endif
+
+    // returns the first character at or after Ptr that is not of class CC
+    template <CharClass CC>
+    inline const char *skip(const char *Ptr, const char *End)
+    {
+#ifdef GOAL_LEXER_SIMD
+        if (HasAVX2)
+            return scanAVX2<CC>(Ptr, End);
+        return scanSSE2<CC>(Ptr, End);
+#else
+        (void)End;
+        return scanScalar<CC>(Ptr);
+#endif
+    }
+}
+
+// keywords are classified by length and first character, so an identifier
+// costs at most one short comparison instead of a chain of StringRef ==
+static Token::TokenKind getKeywordKind(llvm::StringRef Name)
 {
-    while (*BufferPtr && charinfo::isWhitespace(*BufferPtr))
+    const char *S = Name.data();
+    switch (Name.size())
     {
-        ++BufferPtr;
+    case 2:
+        if (S[0] == 'i' && S[1] == 'f')
+            return Token::IF;
+        if (S[0] == 'o' && S[1] == 'r')
+            return Token::OR;
+        break;
+    case 3:
+        switch (S[0])
+        {
+        case 'i':
+            if (S[1] == 'n' && S[2] == 't')
+                return Token::KW_int;
+            break;
+        case 'e':
+            if (S[1] == 'n' && S[2] == 'd')
+                return Token::end;
+            break;
+        case 'a':
+            if (S[1] == 'n' && S[2] == 'd')
+                return Token::AND;
+            break;
+        }
+        break;
+    case 4:
+        if (S[0] == 'e' && S[1] == 'l')
+        {
+            if (S[2] == 'i' && S[3] == 'f')
+                return Token::ELIF;
+            if (S[2] == 's' && S[3] == 'e')
+                return Token::ELSE;
+        }
+        break;
+    case 5:
+        if (S[0] == 'b' && memcmp(S + 1, "egin", 4) == 0)
+            return Token::begin;
+        if (S[0] == 'l' && memcmp(S + 1, "oopc", 4) == 0)
+            return Token::loopc;
+        break;
     }
+    return Token::id;
+}
+
+void Lexer::next(Token &token)
+{
+    BufferPtr = scan::skip<scan::Whitespace>(BufferPtr, BufferEnd);
     // make sure we didn't reach the end of input
     if (!*BufferPtr)
     {
         token.Kind = Token::eoi;
+        token.Offset = uint32_t(BufferPtr - BufferStart);
+        token.Sym = SymbolTable::None;
         return;
     }
     // collect characters and check for keywords or ident
     if (charinfo::isLetter(*BufferPtr))
     {
-        const char *end = BufferPtr + 1;
-        while (charinfo::isLetter(*end))
-            ++end;
+        const char *end = scan::skip<scan::Letter>(BufferPtr + 1, BufferEnd);
         llvm::StringRef Name(BufferPtr, end - BufferPtr);
-        Token::TokenKind kind;
-        if (Name == "int")
-            kind = Token::KW_int;
-        else if (Name == "begin")
-            kind = Token::begin;
-        else if (Name == "end")
-            kind = Token::end;
-        else if (Name == "and")
-            kind = Token::AND;
-        else if (Name == "or")
-            kind = Token::OR ;
-        else if (Name == "if")
-            kind = Token::IF;
-        else if (Name == "elif")
-            kind = Token::ELIF;
-        else if (Name == "else")
-            kind = Token::ELSE;
-        else if (Name == "loopc")
-            kind = Token::loopc;
-        else
-            kind = Token::id;
+        Token::TokenKind kind = getKeywordKind(Name);
         // generate the token
         formToken(token, end, kind);
+        if (kind == Token::id && Symbols)
+            token.Sym = Symbols->intern(Name);
         return;
     }
     // check for numbers
     else if (charinfo::isDigit(*BufferPtr))
     {
-        const char *end = BufferPtr + 1;
-        while (charinfo::isDigit(*end))
-            ++end;
+        const char *end = scan::skip<scan::Digit>(BufferPtr + 1, BufferEnd);
         formToken(token, end, Token::number);
         return;
     }
@@ -87,47 +229,47 @@ void Lexer::next(Token &token)
         llvm::StringRef Name(BufferPtr, end - BufferPtr);
         Token::TokenKind kind;
         if (Name == "+") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::plus_equal;
             else
                 kind = Token::plus;
         } else if (Name == "-") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::minus_equal;
             else
                 kind = Token::minus;
         } else if (Name == "*") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::mul_equal;
             else
                 kind = Token::mul;
         } else if (Name == "/") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::slash_equal;
             else
                 kind = Token::slash;
         } else if (Name == ">") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::gte;
             else
                 kind = Token::gt;
         } else if (Name == "<") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::lte;
             else
                 kind = Token::lt;
         } else if (Name == "!") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::not_equal;
             else
                 kind = Token::unknown;
         } else if (Name == "=") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::is_equal;
             else
                 kind = Token::equal;
         } else if (Name == "%") {
-            if (end == "=")
+            if (*end == '=')
                 kind = Token::mod_equal;
             else
                 kind = Token::mod;
@@ -146,7 +288,7 @@ void Lexer::next(Token &token)
         else
             kind = Token::unknown;
 
-        if (charinfo::isDoubleOperation(Name[0]) && end == "=")
+        if (charinfo::isDoubleOperation(Name[0]) && *end == '=')
             end++;
         // generate the token
         formToken(token, end, kind);
@@ -158,6 +300,8 @@ void Lexer::formToken(Token &Tok, const char *TokEnd,
                       Token::TokenKind Kind)
 {
     Tok.Kind = Kind;
+    Tok.Offset = uint32_t(BufferPtr - BufferStart);
+    Tok.Sym = SymbolTable::None;
     Tok.Text = llvm::StringRef(BufferPtr, TokEnd - BufferPtr);
     BufferPtr = TokEnd;
 }
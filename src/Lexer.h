@@ -3,12 +3,18 @@
 
 #include "llvm/ADT/StringRef.h"        // encapsulates a pointer to a C string and its length
 #include "llvm/Support/MemoryBuffer.h" // read-only access to a block of memory, filled with the content of a file
+#include "SymbolTable.h"
+#include <cstdint>
 
 class Lexer;
+class TokenStream;
+class StreamingLexer;
 
 class Token
 {
-    friend class Lexer; // Lexer can access private and protected members of Token
+    friend class Lexer;       // Lexer can access private and protected members of Token
+    friend class TokenStream; // rebuilds tokens from its compact arrays
+    friend class StreamingLexer;
 
 public:
     enum TokenKind : unsigned short
@@ -48,15 +54,21 @@ public:
         loopc,      // exclamation
         l_paren,
         r_paren,
-        KW_int
+        KW_int,
+        NUM_TOKENS // number of token kinds, keep last
     };
 
 
 private:
-    TokenKind Kind;
+    // a default-constructed token is an empty eoi at offset 0
+    TokenKind Kind = eoi;
+    uint32_t Offset = 0;  // offset of the token in the input, see LineTable
+    uint32_t Sym = SymbolTable::None; // interned ID of an identifier, SymbolTable::None otherwise
     llvm::StringRef Text; // points to the start of the text of the token
 public:
     TokenKind getKind() const { return Kind; }
+    uint32_t getOffset() const { return Offset; }
+    uint32_t getSym() const { return Sym; }
     llvm::StringRef getText() const { return Text; }
 
     // to test if the token is of a certain kind
@@ -74,16 +86,30 @@ class Lexer
 {
     const char *BufferStart; // pointer to the beginning of the input
     const char *BufferPtr;   // pointer to the next unprocessed character
+    const char *BufferEnd;   // pointer to the terminating NUL
+    SymbolTable *Symbols;    // interns identifiers if set
 
 public:
-    Lexer(const llvm::StringRef &Buffer)
+    Lexer(const llvm::StringRef &Buffer, SymbolTable *Symbols = nullptr)
     {
         BufferStart = Buffer.begin();
         BufferPtr = BufferStart;
+        BufferEnd = Buffer.end();
+        this->Symbols = Symbols;
+    }
+
+    // lexes Buffer starting at Start; token offsets stay relative to the
+    // beginning of Buffer
+    Lexer(const llvm::StringRef &Buffer, size_t Start, SymbolTable *Symbols = nullptr)
+        : Lexer(Buffer, Symbols)
+    {
+        BufferPtr = BufferStart + Start;
     }
 
     void next(Token &token); // return the next token
 
+    const char *getBufferStart() const { return BufferStart; }
+
 private:
     void formToken(Token &Result, const char *TokEnd, Token::TokenKind Kind);
 };
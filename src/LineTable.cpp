@@ -0,0 +1,36 @@
+#include "LineTable.h"
+#include <algorithm>
+#include <cstring>
+
+// memchr is vectorized in common C libraries, so the scan runs many bytes
+// per step instead of comparing each character
+void LineTable::build() const
+{
+    LineStarts.push_back(0);
+    const char *Start = Buffer.data();
+    const char *Ptr = Start;
+    const char *End = Start + Buffer.size();
+    while (Ptr < End)
+    {
+        const char *NL = static_cast<const char *>(memchr(Ptr, '\n', End - Ptr));
+        if (!NL)
+            break;
+        LineStarts.push_back(uint32_t(NL + 1 - Start));
+        Ptr = NL + 1;
+    }
+}
+
+std::pair<unsigned, unsigned> LineTable::getLineAndColumn(uint32_t Offset) const
+{
+    std::call_once(Built, [this] { build(); });
+    // the last line start that is <= Offset
+    auto It = std::upper_bound(LineStarts.begin(), LineStarts.end(), Offset) - 1;
+    unsigned Line = unsigned(It - LineStarts.begin()) + 1;
+    return std::make_pair(Line, Offset - *It + 1);
+}
+
+void LineTable::print(llvm::raw_ostream &OS, uint32_t Offset) const
+{
+    std::pair<unsigned, unsigned> LC = getLineAndColumn(Offset);
+    OS << LC.first << ":" << LC.second;
+}
@@ -0,0 +1,44 @@
+#ifndef LINETABLE_H
+#define LINETABLE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// LineTable maps the 32-bit source offsets stored in tokens and AST nodes
+// to line:column. The table of line starts is only built the first time a
+// location is printed, so keeping offsets costs nothing until a
+// diagnostic is reported. Lookups are thread-safe.
+class LineTable
+{
+    llvm::StringRef Buffer;
+    mutable std::vector<uint32_t> LineStarts; // empty until first use
+    mutable std::once_flag Built;
+
+public:
+    explicit LineTable(llvm::StringRef Buffer) : Buffer(Buffer) {}
+
+    // 1-based line and column of Offset
+    std::pair<unsigned, unsigned> getLineAndColumn(uint32_t Offset) const;
+
+    // prints "line:col"
+    void print(llvm::raw_ostream &OS, uint32_t Offset) const;
+
+private:
+    void build() const;
+};
+
+// prints "line:col: " or, without a table (e.g. chunked input), "offset N: "
+inline llvm::raw_ostream &printLoc(llvm::raw_ostream &OS, const LineTable *Lines,
+                                   uint32_t Offset)
+{
+    if (Lines)
+        Lines->print(OS, Offset);
+    else
+        OS << "offset " << Offset;
+    return OS << ": ";
+}
+
+#endif
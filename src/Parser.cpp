@@ -1,375 +1,550 @@
 #include "Parser.h"
+#include "llvm/Support/ThreadPool.h"
+#include <algorithm>
+#include <vector>
 
 // main point is that the whole input has been consumed
 AST *Parser::parse()
 {
     AST *Res = parseGoal();
+    printDiagnostics();
     return Res;
 }
 
-AST *Parser::parseGoal()
+void Parser::printDiagnostics()
 {
-    Expr *E;
-    llvm::SmallVector<Expr*> Vars;
+    for (const Diagnostic &D : Diags)
+        printLoc(llvm::errs(), Lines, D.Offset) << D.Message << D.Text << "\n";
+    Diags.clear();
+}
 
+// Panic-mode recovery after a syntax error: skips to just past the next
+// ';' outside nested begin/end blocks, or to an 'end' without a 'begin'.
+// Inside a block that 'end' closes the block and is left for the block
+// to consume; at top level it is stray and skipped.
+void Parser::recover(bool InBlock)
+{
+    int Depth = 0;
     while (!Tok.is(Token::eoi))
     {
-        if (Tok.is(Token::KW_int))
-         {
-            Expr *d;
-            d = parseDefine();   
-            if (d)
-                 Vars.push_back();
-             else
-                goto _error1;
-         } 
-        if (Tok.is(Token::id))
-        {
-            Expr *d;
-            d = parseAssignment();
-            if (!Tok.is(Token::semicolon))
-            {
-                error();
-                goto _error1;
-            }
-            if (d)
-                Vars.push_back(d);
-            else
-                goto _error1;
-        } 
-        else if (Tok.is(Token::IF)) 
+        if (Tok.is(Token::begin))
+            ++Depth;
+        else if (Tok.is(Token::end) && Depth == 0)
         {
-            Expr *d;
-            d = parseIF();   
-            if (d)
-                Vars.push_back(d);
-            else
-                goto _error1;
-        } 
-        else if (Tok.is(Token::loopc))
+            if (!InBlock)
+                advance();
+            return;
+        }
+        else if (Tok.is(Token::end))
+            --Depth;
+        else if (Tok.is(Token::semicolon) && Depth == 0)
         {
-            Expr *d;
-            d = parseLoop();   
-            if (d)
-                Vars.push_back(d); 
-            else
-                goto _error1;
+            advance();
+            return;
         }
         advance();
     }
-    return new Goal(Vars);
+}
 
- _error1:
-    while(Tok.getKind() != Token::eoi)
-    advance();
-    return nullptr;
+AST *Parser::parseGoal()
+{
+    llvm::SmallVector<Expr*> Vars;
+    llvm::SmallVector<StmtRange, 0> Ranges;
+
+    // a statement with a syntax error is dropped and parsing goes on, so
+    // one run reports every error
+    while (!Tok.is(Token::eoi))
+    {
+        StmtRange R;
+        Expr *d = parseTopLevelStatement(R);
+        if (!d)
+            continue;
+        Vars.push_back(d);
+        Ranges.push_back(R);
+    }
+    return Ctx.create<Goal>(Vars, Ranges);
+}
+
+// Expr -> Define | Assignment | Condition | Loop, followed by ';'
+Expr *Parser::parseStatement()
+{
+    Expr *d;
+    switch (Tok.getKind())
+    {
+    case Token::KW_int:
+        d = parseDefine(); // consumes its own ';'
+        break;
+    case Token::id:
+        d = parseAssignment(); // consumes its own ';'
+        break;
+    case Token::IF:
+        d = parseCondition();
+        if (d && consume(Token::semicolon))
+            d = nullptr;
+        break;
+    case Token::loopc:
+        d = parseLoop();
+        if (d && consume(Token::semicolon))
+            d = nullptr;
+        break;
+    default:
+        error();
+        d = nullptr;
+        break;
+    }
+    if (!d)
+        recover(/*InBlock=*/false);
+    return d;
+}
+
+Expr *Parser::parseTopLevelStatement(StmtRange &Range)
+{
+    Range.Begin = Tok.getOffset();
+    Range.LocDelta = 0;
+    Range.Hash = 0;
+    Expr *d = parseStatement();
+    Range.End = PrevEnd;
+    return d;
+}
+
+void Parser::parseStatements(size_t End, llvm::SmallVectorImpl<Expr *> &Stmts,
+                             llvm::SmallVectorImpl<StmtRange> &Ranges)
+{
+    // StreamPos is one past the index of Tok
+    while (!Tok.is(Token::eoi) && StreamPos - 1 < End)
+    {
+        StmtRange R;
+        Expr *d = parseTopLevelStatement(R);
+        if (!d)
+            continue;
+        Stmts.push_back(d);
+        Ranges.push_back(R);
+    }
 }
 
 Expr *Parser::parseDefine()
 {
-    Expr *E;
+    Expr *D;
     llvm::SmallVector<llvm::StringRef, 8> Vars;
-    if (expect(Token::KW_int))
-        goto _error2;
-
-    advance();
+    llvm::SmallVector<uint32_t, 8> Syms;
+    llvm::SmallVector<Expr *> Exprs;
+    uint32_t Loc = Tok.getOffset();
+    if (consume(Token::KW_int))
+        return nullptr;
 
     if (expect(Token::id))
-        goto _error2;
+        return nullptr;
     Vars.push_back(Tok.getText());
+    Syms.push_back(Tok.getSym());
     advance();
 
     while (Tok.is(Token::comma))
     {
         advance();
         if (expect(Token::id))
-            goto _error2;
+            return nullptr;
         Vars.push_back(Tok.getText());
+        Syms.push_back(Tok.getSym());
         advance();
     }
 
     if (Tok.is(Token::equal))
     {
-        advance();
-        E = parseExpression();
+        do
+        {
+            advance();
+            Expr *E = parseExpression();
+            if (!E)
+                return nullptr;
+            Exprs.push_back(E);
+        } while (Tok.is(Token::comma));
     }
 
-    if (expect(Token::semicolon))
-        goto _error2;
-
-    return new Define(Token::equal,Vars, E);
+    if (consume(Token::semicolon))
+        return nullptr;
 
-_error2:
-    while(Tok.getKind() != Token::eoi)
-    advance();
-    return nullptr;
+    D = Ctx.create<Define>(Vars, Syms, Exprs);
+    D->setLoc(Loc);
+    return D;
 }
 
+// Condition -> if Expression CompOp Expression : IF (elif C : IF)* (else : IF)?
 Expr *Parser::parseCondition()
 {
-    Expr *E1, *E2, *_IF;
-    llvm::SmallVector<llvm::StringRef, 8> Vars;
-    if (!Tok.is(Token::IF))
-        goto _error3;
-
-    advance();
-    E1 = parseCondition();
-
-    if (!Tok.isOneOf(Token::not_equal,Token::gt,Token::lt,Token::gte,Token::lte, Token::is_equal))
-        goto _error3;
-
-    advance();
-
-    E2 = parseCondition();
-
-    if (!Tok.is(Token::colon))
-        goto _error3;
-
-    advance();
+    llvm::SmallVector<Expr *> Conds;
+    llvm::SmallVector<IF *> Blocks;
+    uint32_t Loc = Tok.getOffset();
+    if (consume(Token::IF))
+        return nullptr;
 
-    _IF = parseIF();
+    Expr *C = parseComparison(/*RequireOp=*/true);
+    if (!C || consume(Token::colon))
+        return nullptr;
+    IF *Body = parseIF();
+    if (!Body)
+        return nullptr;
+    Conds.push_back(C);
+    Blocks.push_back(Body);
 
-    return new Condition(E1, E2, _IF);
+    while (Tok.is(Token::ELIF))
+    {
+        advance();
+        C = parseCompoundCondition();
+        if (!C || consume(Token::colon))
+            return nullptr;
+        Body = parseIF();
+        if (!Body)
+            return nullptr;
+        Conds.push_back(C);
+        Blocks.push_back(Body);
+    }
 
- _error3:  
-    while (Tok.getKind() != Token::eoi)
+    if (Tok.is(Token::ELSE))
+    {
         advance();
-    return nullptr;
-}
+        if (consume(Token::colon))
+            return nullptr;
+        Body = parseIF();
+        if (!Body)
+            return nullptr;
+        Blocks.push_back(Body);
+    }
 
+    Expr *Cond = Ctx.create<Condition>(Conds, Blocks);
+    Cond->setLoc(Loc);
+    return Cond;
+}
 
-Expr *Parser::parseIF()
+// IF -> begin (Assignment)+ end; an assignment with a syntax error is
+// skipped up to its ';' and the rest of the block is still parsed
+IF *Parser::parseIF()
 {
-    Assignment *E;
     llvm::SmallVector<Expr *> assigns;
-    if (expect(Token::begin))
-    {
-        goto _error4;
-    }
-
-    advance();
+    if (consume(Token::begin))
+        return nullptr;
 
-    while (Tok.is(Token::id))
+    while (!Tok.isOneOf(Token::end, Token::eoi))
     {
-        E = (Assignment *)parseAssign();
-        Factor *f = E->getLeft();
-        Factor *t = (Factor *)E->getRight();
+        Expr *E = parseAssignment();
         if (E)
-        {
             assigns.push_back(E);
-        }
         else
+            recover(/*InBlock=*/true);
+    }
+
+    if (consume(Token::end))
+        return nullptr;
+    return Ctx.create<IF>(assigns);
+}
+
+// Expression (CompOp Expression)?, where RequireOp makes the comparison
+// mandatory
+Expr *Parser::parseComparison(bool RequireOp)
+{
+    Expr *Left = parseExpression();
+    if (!Left)
+        return nullptr;
+
+    BinaryOp::Operator Op;
+    switch (Tok.getKind())
+    {
+    case Token::is_equal: Op = BinaryOp::is_equal; break;
+    case Token::not_equal: Op = BinaryOp::not_equal; break;
+    case Token::gt: Op = BinaryOp::gt; break;
+    case Token::gte: Op = BinaryOp::gte; break;
+    case Token::lt: Op = BinaryOp::lt; break;
+    case Token::lte: Op = BinaryOp::lte; break;
+    default:
+        if (RequireOp)
         {
             error();
             return nullptr;
         }
+        return Left;
     }
-
-    if (expect(Token::end))
-    {
-        goto _error4;
-    }
-
+    uint32_t OpLoc = Tok.getOffset();
     advance();
-    return new IF(assigns);
 
-_error4: 
-    while (Tok.getKind() != Token::eoi)
-        advance();
-    return nullptr;
+    Expr *Right = parseExpression();
+    if (!Right)
+        return nullptr;
+    return Ctx.getBinaryOp(Op, Left, Right, OpLoc);
 }
 
-
+// C -> Expression ((and | or) Expression)*, each operand optionally a
+// comparison; and/or associate to the left
 Expr *Parser::parseCompoundCondition()
 {
-    Expr *E;
-    if (!Tok.isOneOf(Token::number, Token::id))
-        goto _error5;
-    
-    E = parseExpression();
+    Expr *Left = parseComparison(/*RequireOp=*/false);
+    if (!Left)
+        return nullptr;
 
     while (Tok.isOneOf(Token::AND, Token::OR))
     {
+        BinaryOp::Operator Op = Tok.is(Token::AND) ? BinaryOp::AND : BinaryOp::OR;
+        uint32_t OpLoc = Tok.getOffset();
         advance();
-        if (!expect(Token::id))
-            goto _error5;
-        Assignments.push_back(Tok.getText());
-        advance();
-    }
-    
-    if (!Tok.is(Token::eoi))
-    {
-        goto _error5;
+        Expr *Right = parseComparison(/*RequireOp=*/false);
+        if (!Right)
+            return nullptr;
+        Left = Ctx.getBinaryOp(Op, Left, Right, OpLoc);
     }
-    
-    return new CompoundCondition(Assignments);
-
- _error5: 
-    while (Tok.getKind() != Token::eoi)
-        advance();
-    return nullptr;
+    return Left;
 }
 
-
-
+// Loop -> loopc C : IF
 Expr *Parser::parseLoop()
 {
-    Expr *C;
-    IF *I;
-    llvm::SmallVector<llvm::StringRef, 8> Assignments;
-    if (!Tok.is(Token::loopc))
-        goto _error6;
-
-    advance();
-
-    C = parseCompoundCondition();
-
-    if (expect(Token::colon))
-        goto _error6;
-    advance();
+    uint32_t Loc = Tok.getOffset();
+    if (consume(Token::loopc))
+        return nullptr;
 
-    I = (IF*)(parseIF());
+    Expr *C = parseCompoundCondition();
+    if (!C || consume(Token::colon))
+        return nullptr;
 
-    return new Loop(C, I);
+    IF *I = parseIF();
+    if (!I)
+        return nullptr;
 
-_error6: 
-    while (Tok.getKind() != Token::eoi)
-        advance();
-    return nullptr;
+    Expr *L = Ctx.create<Loop>(C, I);
+    L->setLoc(Loc);
+    return L;
 }
 
+// Assignment -> ID Op Expression ';'; a compound operator such as '+='
+// is stored as a plain assignment of the corresponding BinaryOp
 Expr *Parser::parseAssignment()
 {
-    Expr *E;
-    Factor *F;
-    F = (Factor *)(parseFactor());
-
+    uint32_t Loc = Tok.getOffset();
+    if (expect(Token::id))
+        return nullptr;
+    Final *F = Ctx.getFinal(Final::Id, Tok.getText(), Tok.getSym(), Tok.getOffset());
+    advance();
 
-    if (!Tok.is(Token::equal) && !Tok.is(Token::plus_equal) && !Tok.is(Token::minus_equal) &&
-        !Tok.is(Token::mod_equal) && !Tok.is(Token::mul_equal) && !Tok.is(Token::slash_equal))
+    Token::TokenKind OpKind = Tok.getKind();
+    uint32_t OpLoc = Tok.getOffset();
+    if (!Tok.isOneOf(Token::equal, Token::plus_equal, Token::minus_equal, Token::mod_equal,
+                     Token::mul_equal, Token::slash_equal))
     {
         error();
         return nullptr;
     }
-
-    advance();
-    E = parseExpr();
-
-    if (expect(Token::semicolon))
-        goto _error7;
-
     advance();
 
-    return new Assignment(F, E);
-    
-_error7: 
-        while (Tok.getKind() != Token::eoi)
-            advance();
+    Expr *E = parseExpression();
+    if (!E || consume(Token::semicolon))
         return nullptr;
-}
 
-Expr *Parser::parseExpression()
-{
-    Expr *Left = parseTerm();
-    while (Tok.isOneOf(Token::plus, Token::minus))
+    switch (OpKind)
     {
-        BinaryOp::Operator Op =
-            Tok.is(Token::plus) ? BinaryOp::Plus : BinaryOp::Minus;
-        advance();
-        Expr *Right = parseTerm();
-        Left = new BinaryOp(Op, Left, Right);
+    case Token::plus_equal: E = Ctx.getBinaryOp(BinaryOp::Plus, F, E, OpLoc); break;
+    case Token::minus_equal: E = Ctx.getBinaryOp(BinaryOp::Minus, F, E, OpLoc); break;
+    case Token::mul_equal: E = Ctx.getBinaryOp(BinaryOp::Mul, F, E, OpLoc); break;
+    case Token::slash_equal: E = Ctx.getBinaryOp(BinaryOp::Div, F, E, OpLoc); break;
+    case Token::mod_equal: E = Ctx.getBinaryOp(BinaryOp::mod, F, E, OpLoc); break;
+    default: break;
     }
-    return Left;
+
+    Expr *A = Ctx.create<Assignment>(F, E);
+    A->setLoc(Loc);
+    return A;
 }
 
-Expr *Parser::parseTerm()
+// operator table for parseExpression; adding a binary operator only takes
+// a new row here
+namespace
 {
-    Expr *Left = parseFactor();
-    while (Tok.isOneOf(Token::mul, Token::slash,Token::mod))
+    struct BinaryOpInfo
     {
-        BinaryOp::Operator Op =
-            Tok.is(Token::mul) ? BinaryOp::Mul : (Tok.is(Token::mod? BinaryOp::mod:BinaryOp::Div));
-        advance();
-        Expr *Right = parseFactor();
-        Left = new Assignment(Op, Left, Right);
-    }
-    return Left;
+        Token::TokenKind Kind;
+        unsigned char Prec;   // 0 means "not a binary operator"
+        bool RightAssoc;
+        BinaryOp::Operator Op;
+    };
+
+    const BinaryOpInfo BinaryOps[] = {
+        {Token::plus, 1, false, BinaryOp::Plus},
+        {Token::minus, 1, false, BinaryOp::Minus},
+        {Token::mul, 2, false, BinaryOp::Mul},
+        {Token::slash, 2, false, BinaryOp::Div},
+        {Token::mod, 2, false, BinaryOp::mod},
+        {Token::power, 3, true, BinaryOp::power},
+    };
+
+    // BinaryOps indexed by token kind, so the lookup is a single load
+    class BinaryOpTable
+    {
+        BinaryOpInfo ByKind[Token::NUM_TOKENS];
+
+    public:
+        BinaryOpTable()
+        {
+            for (unsigned K = 0; K < Token::NUM_TOKENS; ++K)
+                ByKind[K] = {Token::TokenKind(K), 0, false, BinaryOp::Plus};
+            for (const BinaryOpInfo &Info : BinaryOps)
+                ByKind[Info.Kind] = Info;
+        }
+
+        const BinaryOpInfo &operator[](Token::TokenKind K) const { return ByKind[K]; }
+    };
+
+    const BinaryOpTable OpTable;
 }
 
-Expr *Parser::parseFactor()
+// Expression, Term, Factor and Final are parsed by operator precedence
+// with explicit operand and operator stacks instead of recursion, so
+// nesting depth (parentheses or long operator chains) costs heap memory,
+// not call stack. An open parenthesis sits on the operator stack as a
+// marker that operators never reduce past.
+namespace
 {
-    Expr *Left = parseFinal();
-    while (Tok.is(Token::power))
+    struct PendingOp
     {
-        BinaryOp::Operator Op =BinaryOp::power;
-        Expr *Right = parseFinal();
-        Left = new BinaryOp(Op, Left, Right);
-    }
-    return Left;
+        const BinaryOpInfo *Info; // null for an open parenthesis
+        uint32_t Loc;
+    };
 }
 
-Expr *Parser::parseAssignment()
+Expr *Parser::parseExpression()
 {
-    Expr *E;
-    if (!Tok.is(Token::id))
-        goto _error8;
+    llvm::SmallVector<Expr *, 16> Operands;
+    llvm::SmallVector<PendingOp, 16> Ops;
+    size_t OpenParens = 0;
 
-    advance();
-
-    if (!Tok.isOneOf(Token::minus_equal, Token::mul_equal, Token::plus_equal, Token::slash_equal, Token::mod_equal, Token::equal))
-        goto _error8;
-        
-    advance();
+    // pops the top operator and its two operands into a BinaryOp
+    auto Reduce = [&]()
+    {
+        PendingOp Op = Ops.pop_back_val();
+        Expr *Right = Operands.pop_back_val();
+        Expr *Left = Operands.pop_back_val();
+        Operands.push_back(Ctx.getBinaryOp(Op.Info->Op, Left, Right, Op.Loc));
+    };
 
-    if (Tok.is(Token::l_paren))
+    while (true)
     {
+        // operand: any number of '(' and then an identifier or number
+        while (Tok.is(Token::l_paren))
+        {
+            Ops.push_back({nullptr, Tok.getOffset()});
+            ++OpenParens;
+            advance();
+        }
+        if (!Tok.isOneOf(Token::id, Token::number))
+        {
+            error();
+            return nullptr;
+        }
+        // literals are int; a larger one is reported but parsing goes on
+        int Value;
+        if (Tok.is(Token::number) && Tok.getText().getAsInteger(10, Value))
+            error("Integer literal out of range: ");
+        Operands.push_back(Ctx.getFinal(Tok.is(Token::id) ? Final::Id : Final::Number, Tok.getText(),
+                                        Tok.getSym(), Tok.getOffset()));
         advance();
-        E = parseExpression();
-        if (!Tok.is(Token::r_paren))
+
+        // a ')' closes the innermost open parenthesis; one that was never
+        // opened here ends the expression and is left to the caller
+        while (Tok.is(Token::r_paren) && OpenParens)
         {
-            goto _error8;
+            while (Ops.back().Info)
+                Reduce();
+            Ops.pop_back();
+            --OpenParens;
+            advance();
         }
+
+        const BinaryOpInfo &Info = OpTable[Tok.getKind()];
+        if (Info.Prec == 0)
+            break;
+        // operators that bind at least as tight are complete, except that
+        // a right-associative one waits for its right operand
+        while (!Ops.empty() && Ops.back().Info &&
+               (Ops.back().Info->Prec > Info.Prec ||
+                (Ops.back().Info->Prec == Info.Prec && !Info.RightAssoc)))
+            Reduce();
+        Ops.push_back({&Info, Tok.getOffset()});
         advance();
     }
-    else
+
+    if (OpenParens)
     {
-        goto _error8;
+        expect(Token::r_paren);
+        return nullptr;
     }
-    
-    return new Assignment(E);
+    while (!Ops.empty())
+        Reduce();
+    return Operands.back();
+}
 
- _error8:
-        while (Tok.getKind() != Token::eoi)
-            advance();
-        return nullptr;
+// a ';' ends a top-level statement only outside begin/end blocks; a
+// stray 'end' is a syntax error the chunk parser reports, and must not
+// stop the following statements from being split
+static std::vector<size_t> findStatementBounds(const TokenStream &Stream, size_t Parts)
+{
+    std::vector<size_t> Bounds(1, 0);
+    size_t Size = Stream.size() - 1; // without eoi
+    size_t Target = Size / Parts;
+    unsigned Depth = 0;
+    for (size_t I = 0; I < Size; ++I)
+    {
+        Token::TokenKind K = Stream.getKind(I);
+        if (K == Token::begin)
+            ++Depth;
+        else if (K == Token::end && Depth > 0)
+            --Depth;
+        else if (K == Token::semicolon && Depth == 0 && I + 1 - Bounds.back() >= Target &&
+                 Bounds.size() < Parts)
+            Bounds.push_back(I + 1);
+    }
+    Bounds.push_back(Size);
+    return Bounds;
 }
 
-Expr *Parser::parseFinal()
+AST *Parser::parseParallel(TokenStream &Stream, ASTContext &Ctx, unsigned Threads,
+                           const LineTable *Lines, bool &HasError)
 {
-    Expr *E;
-    if (Tok.is(Token::l_paren))
+    // more ranges than threads, so uneven statements still balance
+    const size_t RangesPerThread = 4;
+    const size_t MinRangeTokens = 4096;
+    size_t Parts = std::max<size_t>(1, std::min<size_t>(Threads * RangesPerThread,
+                                                         Stream.size() / MinRangeTokens));
+    std::vector<size_t> Bounds = findStatementBounds(Stream, Parts);
+    size_t NumRanges = Bounds.size() - 1;
+
+    // every range gets its own arena, owned by Ctx once the tree is built
+    std::vector<ASTContext *> Arenas;
+    for (size_t I = 0; I < NumRanges; ++I)
+        Arenas.push_back(&Ctx.createChild());
+
+    std::vector<llvm::SmallVector<Expr *>> Stmts(NumRanges);
+    std::vector<llvm::SmallVector<StmtRange, 0>> StmtRanges(NumRanges);
+    std::vector<llvm::SmallVector<Diagnostic, 0>> Diags(NumRanges);
+    auto ParseRange = [&](size_t I)
     {
-        advance();
-        E = parseExpression();
-        if (!Tok.is(Token::r_paren))
-        {
-            goto _error9;
-        }
-        advance();
-    } 
-    else if (Tok.isOneOf(Token::id, Token::number))
+        Parser P(Stream, *Arenas[I], Bounds[I]);
+        P.parseStatements(Bounds[I + 1], Stmts[I], StmtRanges[I]);
+        Diags[I] = std::move(P.Diags);
+    };
+
     {
-        E = Tok.getText();
+        llvm::ThreadPool Pool(llvm::hardware_concurrency(Threads));
+        for (size_t I = 0; I < NumRanges; ++I)
+            Pool.async(ParseRange, I);
+        Pool.wait();
     }
-    else
+
+    // merge in source order, diagnostics included
+    llvm::SmallVector<Expr *> All;
+    llvm::SmallVector<StmtRange, 0> AllRanges;
+    HasError = false;
+    for (size_t I = 0; I < NumRanges; ++I)
     {
-        goto _error9;
+        HasError |= !Diags[I].empty();
+        for (const Diagnostic &D : Diags[I])
+            printLoc(llvm::errs(), Lines, D.Offset) << D.Message << D.Text << "\n";
+        All.append(Stmts[I].begin(), Stmts[I].end());
+        AllRanges.append(StmtRanges[I].begin(), StmtRanges[I].end());
     }
-    
-    return Final(E);
-
- _error9:
-        while (Tok.getKind() != Token::eoi)
-            advance();
-        return nullptr;
+    return Ctx.create<Goal>(All, AllRanges);
 }
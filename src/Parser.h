@@ -2,24 +2,65 @@
 #define PARSER_H
 
 #include "AST.h"
+#include "ASTContext.h"
 #include "Lexer.h"
+#include "LineTable.h"
+#include "StreamingLexer.h"
+#include "TokenStream.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cassert>
+#include <string>
 
 class Parser
 {
-    Lexer &Lex;    // retrieve the next token from the input
-    Token Tok;     // stores the next token
+    // a syntax error, kept until printDiagnostics()
+    struct Diagnostic
+    {
+        uint32_t Offset;
+        const char *Message; // printed before Text
+        std::string Text;    // of the offending token
+    };
+
+    Lexer *Lex;           // retrieve the next token from the input
+    TokenStream *Stream;  // pre-lexed tokens, used instead of Lex when set
+    StreamingLexer *Chunked; // chunked input, used instead of Lex when set
+    size_t StreamPos;     // index of the token after Tok in Stream
+    Token Tok;            // stores the next token
+    ASTContext &Ctx;      // allocates the nodes of the tree
     bool HasError; // indicates if an error was detected
+    const LineTable *Lines = nullptr; // resolves token offsets in diagnostics
+    uint32_t PrevEnd = 0; // offset just past the token before Tok
+    llvm::SmallVector<Diagnostic, 0> Diags; // in source order
 
-    void error()
+    void error(const char *Message = "Unexpected: ")
     {
-        llvm::errs() << "Unexpected: " << Tok.getText() << "\n";
+        Diags.push_back({Tok.getOffset(), Message, Tok.getText().str()});
         HasError = true;
     }
 
+    // skips the rest of a statement with a syntax error, see Parser.cpp
+    void recover(bool InBlock);
+
     // retrieves the next token from the lexer.expect()
     // tests whether the look-ahead is of the expected kind
-    void advance() { Lex.next(Tok); }
+    void advance()
+    {
+        PrevEnd = Tok.getOffset() + uint32_t(Tok.getText().size());
+        if (Stream)
+            Stream->getToken(StreamPos++, Tok);
+        else if (Chunked)
+            Chunked->next(Tok);
+        else
+            Lex->next(Tok);
+    }
+
+    // kind of the token N positions after Tok (peek(0) is the token after
+    // Tok); only available when parsing from a TokenStream
+    Token::TokenKind peek(unsigned N)
+    {
+        assert(Stream && "lookahead requires a pre-lexed TokenStream");
+        return Stream->getKind(StreamPos + N);
+    }
 
     bool expect(Token::TokenKind Kind)
     {
@@ -46,31 +87,68 @@ class Parser
     // Expr *parseDec();
     AST *parseGoal();
     Expr *parseStatement();
+    // parses top-level statements until Tok is at token index End
+    void parseStatements(size_t End, llvm::SmallVectorImpl<Expr *> &Stmts,
+                         llvm::SmallVectorImpl<StmtRange> &Ranges);
     Expr *parseDefine();
     Expr *parseCondition();
-    Expr *parseIF();
-    Expr *parseElif();
-    Expr *parseElse();
+    IF *parseIF();
+    Expr *parseComparison(bool RequireOp);
     Expr *parseCompoundCondition();
     Expr *parseLoop();
-    Expr *parseAssign();
-    Expr *parseExpression();  // Expression Grammar
-    Expr *parseTerm();
-    Expr *parseFactor();
+    Expr *parseExpression();  // Expression, Term, Factor and Final
     Expr *parseAssignment();
-    Expr *parseFinal();
 
 public:
     // initializes all members and retrieves the first token
-    Parser(Lexer &Lex) : Lex(Lex), HasError(false)
+    Parser(Lexer &Lex, ASTContext &Ctx)
+        : Lex(&Lex), Stream(nullptr), Chunked(nullptr), StreamPos(0), Ctx(Ctx), HasError(false)
+    {
+        advance();
+    }
+
+    // parses from tokens lexed up front starting at token index Begin,
+    // enabling peek()
+    Parser(TokenStream &Stream, ASTContext &Ctx, size_t Begin = 0)
+        : Lex(nullptr), Stream(&Stream), Chunked(nullptr), StreamPos(Begin), Ctx(Ctx), HasError(false)
+    {
+        advance();
+    }
+
+    // parses input read chunk by chunk; the lexer must save token texts
+    Parser(StreamingLexer &Chunked, ASTContext &Ctx)
+        : Lex(nullptr), Stream(nullptr), Chunked(&Chunked), StreamPos(0), Ctx(Ctx), HasError(false)
     {
         advance();
     }
 
+    // report diagnostics as line:col instead of raw offsets
+    void setLineTable(const LineTable *L) { Lines = L; }
+
     // get the value of error flag
     bool hasError() { return HasError; }
 
+    // parses the whole input; statements with syntax errors are skipped
+    // and every error is reported
     AST *parse();
+
+    // prints the syntax errors found so far, in source order
+    void printDiagnostics();
+
+    // parses one top-level statement and records its source extent
+    Expr *parseTopLevelStatement(StmtRange &Range);
+
+    bool atEnd() { return Tok.is(Token::eoi); }
+
+    // offset of the next unparsed token
+    uint32_t getOffset() { return Tok.getOffset(); }
+
+    // Splits Stream at top-level statement boundaries and parses the
+    // ranges on Threads worker threads, each into an arena of its own
+    // owned by Ctx. The statements are merged into one Goal in source
+    // order, and so are their diagnostics.
+    static AST *parseParallel(TokenStream &Stream, ASTContext &Ctx, unsigned Threads,
+                              const LineTable *Lines, bool &HasError);
 };
 
 #endif
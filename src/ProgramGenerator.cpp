@@ -0,0 +1,169 @@
+#include "ProgramGenerator.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    class Generator
+    {
+        const GeneratorOptions &Opts;
+        llvm::raw_ostream &OS;
+        std::mt19937 Rng;
+        std::vector<std::string> Names;
+
+        unsigned pick(unsigned N) { return unsigned(Rng() % N); }
+
+        // identifiers are letters only, so variable I is spelled in base 26
+        static std::string name(unsigned I)
+        {
+            std::string S = "v";
+            do
+            {
+                S += char('a' + I % 26);
+                I /= 26;
+            } while (I);
+            return S;
+        }
+
+        void final()
+        {
+            if (pick(2))
+                OS << Names[pick(Names.size())];
+            else
+                OS << (1 + pick(100));
+        }
+
+        // Expression nested Depth levels deep: each level wraps the previous
+        // one in parentheses and applies one operator, so Expression, Term,
+        // Factor and Final are all reached. Divisors and exponents are
+        // non-zero literals.
+        void expression(unsigned Depth)
+        {
+            if (Depth == 0)
+            {
+                final();
+                return;
+            }
+            OS << "(";
+            expression(Depth - 1);
+            switch (pick(6))
+            {
+            case 0: OS << " + "; final(); break;
+            case 1: OS << " - "; final(); break;
+            case 2: OS << " * "; final(); break;
+            case 3: OS << " / " << (1 + pick(9)); break;
+            case 4: OS << " % " << (1 + pick(9)); break;
+            case 5: OS << " ^ " << (1 + pick(3)); break;
+            }
+            OS << ")";
+        }
+
+        // Like the divisors in expression(), the right side of /= and %=
+        // is a non-zero literal, so generated programs run without trapping.
+        void assignment()
+        {
+            static const char *Ops[] = {"=", "+=", "-=", "*=", "/=", "%="};
+            unsigned Op = pick(6);
+            OS << Names[pick(Names.size())] << " " << Ops[Op] << " ";
+            if (Op >= 4)
+                OS << (1 + pick(9));
+            else
+                expression(Opts.ExprDepth);
+            OS << ";";
+        }
+
+        void block()
+        {
+            OS << "begin\n";
+            for (unsigned I = 0; I < std::max(Opts.BlockSize, 1u); ++I)
+            {
+                OS << "  ";
+                assignment();
+                OS << "\n";
+            }
+            OS << "end";
+        }
+
+        // C -> Expression ((and | or) Expression)*
+        void compound()
+        {
+            expression(Opts.ExprDepth);
+            if (pick(2))
+            {
+                OS << (pick(2) ? " and " : " or ");
+                expression(Opts.ExprDepth);
+            }
+        }
+
+        void condition()
+        {
+            static const char *CompOps[] = {"<=", ">=", "==", "!=", ">", "<"};
+            OS << "if ";
+            expression(Opts.ExprDepth);
+            OS << " " << CompOps[pick(6)] << " ";
+            expression(Opts.ExprDepth);
+            OS << ": ";
+            block();
+            for (unsigned I = 0; I < Opts.Elifs; ++I)
+            {
+                OS << "\nelif ";
+                compound();
+                OS << ": ";
+                block();
+            }
+            OS << "\nelse: ";
+            block();
+            OS << ";";
+        }
+
+        void loop()
+        {
+            OS << "loopc ";
+            compound();
+            OS << ": ";
+            block();
+            OS << ";";
+        }
+
+        void statement()
+        {
+            ProgramShape Shape = Opts.Shape;
+            if (Shape == ProgramShape::Mixed)
+            {
+                // mostly assignments, like the programs we generate
+                unsigned R = pick(10);
+                Shape = R < 6 ? ProgramShape::Assignments
+                              : (R < 8 ? ProgramShape::Conditions : ProgramShape::Loops);
+            }
+            switch (Shape)
+            {
+            case ProgramShape::Conditions: condition(); break;
+            case ProgramShape::Loops: loop(); break;
+            default: assignment(); break;
+            }
+            OS << "\n";
+        }
+
+    public:
+        Generator(const GeneratorOptions &Opts, llvm::raw_ostream &OS)
+            : Opts(Opts), OS(OS), Rng(Opts.Seed) {}
+
+        void run()
+        {
+            for (unsigned I = 0; I < std::max(Opts.Variables, 1u); ++I)
+            {
+                Names.push_back(name(I));
+                OS << "int " << Names.back() << " = " << pick(100) << ";\n";
+            }
+            for (uint64_t I = 0; I < Opts.Statements; ++I)
+                statement();
+        }
+    };
+}
+
+void generateProgram(const GeneratorOptions &Opts, llvm::raw_ostream &OS)
+{
+    Generator(Opts, OS).run();
+}
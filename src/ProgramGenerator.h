@@ -0,0 +1,31 @@
+#ifndef PROGRAMGENERATOR_H
+#define PROGRAMGENERATOR_H
+
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+
+// Shapes of the statements after the variable definitions.
+enum class ProgramShape
+{
+    Mixed,       // assignments, conditions and loops
+    Assignments, // only assignments
+    Conditions,  // only if/elif/else chains
+    Loops        // only loopc statements
+};
+
+struct GeneratorOptions
+{
+    uint64_t Statements = 1000; // top-level statements after the definitions
+    unsigned Variables = 16;    // variables, each in its own int definition
+    unsigned ExprDepth = 2;     // parenthesized nesting of each expression
+    unsigned Elifs = 1;         // elif branches per condition
+    unsigned BlockSize = 2;     // assignments per begin/end block
+    ProgramShape Shape = ProgramShape::Mixed;
+    uint32_t Seed = 1;          // same options and seed give the same program
+};
+
+// Writes a program that follows Grammar.txt and passes Sema to OS. Output
+// is streamed, so programs of any size can be generated in constant memory.
+void generateProgram(const GeneratorOptions &Opts, llvm::raw_ostream &OS);
+
+#endif
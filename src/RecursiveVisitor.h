@@ -0,0 +1,179 @@
+#ifndef RECURSIVEVISITOR_H
+#define RECURSIVEVISITOR_H
+
+#include "AST.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
+
+// RecursiveVisitor is a statically dispatched alternative to ASTVisitor.
+// dispatch() switches on the node kind and calls Derived::visit directly,
+// so there is no virtual call per node and the visit bodies can be inlined
+// into the traversal.
+//
+// The default visit methods walk the children. A derived class overrides
+// the ones it needs and pulls in the rest with
+//   using RecursiveVisitor<Derived>::visit;
+//
+// The default walk recurses into operands, so arbitrarily deep
+// expressions should be handled with walkExpression below instead.
+template <typename Derived> class RecursiveVisitor {
+  Derived &derived() { return *static_cast<Derived *>(this); }
+
+public:
+  void dispatch(AST *Node) {
+    switch (Node->getNodeKind()) {
+    case AST::NK_Goal:
+      return derived().visit(*static_cast<Goal *>(Node));
+    case AST::NK_Final:
+      return derived().visit(*static_cast<Final *>(Node));
+    case AST::NK_Condition:
+      return derived().visit(*static_cast<Condition *>(Node));
+    case AST::NK_IF:
+      return derived().visit(*static_cast<IF *>(Node));
+    case AST::NK_BinaryOp:
+      return derived().visit(*static_cast<BinaryOp *>(Node));
+    case AST::NK_Loop:
+      return derived().visit(*static_cast<Loop *>(Node));
+    case AST::NK_Expression:
+      return derived().visit(*static_cast<Expression *>(Node));
+    case AST::NK_Term:
+      return derived().visit(*static_cast<Term *>(Node));
+    case AST::NK_Assignment:
+      return derived().visit(*static_cast<Assignment *>(Node));
+    case AST::NK_Define:
+      return derived().visit(*static_cast<Define *>(Node));
+    }
+  }
+
+  void visit(Goal &Node) {
+    for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
+      dispatch(*I);
+  }
+
+  void visit(Final &) {}
+
+  void visit(Condition &Node) {
+    for (auto I = Node.exprs_begin(), E = Node.exprs_end(); I != E; ++I)
+      dispatch(*I);
+    for (auto I = Node.assignments_begin(), E = Node.assignments_end(); I != E; ++I)
+      dispatch(*I);
+  }
+
+  void visit(IF &Node) {
+    for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
+      dispatch(*I);
+  }
+
+  void visit(BinaryOp &Node) {
+    dispatch(Node.getLeft());
+    dispatch(Node.getRight());
+  }
+
+  void visit(Loop &Node) {
+    dispatch(Node.getExprs());
+    dispatch(Node.getIF());
+  }
+
+  void visit(Expression &Node) {
+    dispatch(Node.getLeft());
+    dispatch(Node.getRight());
+  }
+
+  void visit(Term &Node) {
+    dispatch(Node.getLeft());
+    dispatch(Node.getRight());
+  }
+
+  void visit(Assignment &Node) {
+    dispatch(Node.getLeft());
+    dispatch(Node.getRight());
+  }
+
+  void visit(Define &Node) {
+    for (auto I = Node.begin_values(), E = Node.end_values(); I != E; ++I)
+      dispatch(*I);
+  }
+};
+
+// Operands of the binary expression nodes (BinaryOp, Expression, Term)
+inline Expr *getLeftOperand(Expr *Node) {
+  switch (Node->getNodeKind()) {
+  case AST::NK_BinaryOp:
+    return static_cast<BinaryOp *>(Node)->getLeft();
+  case AST::NK_Expression:
+    return static_cast<Expression *>(Node)->getLeft();
+  default:
+    return static_cast<Term *>(Node)->getLeft();
+  }
+}
+
+inline Expr *getRightOperand(Expr *Node) {
+  switch (Node->getNodeKind()) {
+  case AST::NK_BinaryOp:
+    return static_cast<BinaryOp *>(Node)->getRight();
+  case AST::NK_Expression:
+    return static_cast<Expression *>(Node)->getRight();
+  default:
+    return static_cast<Term *>(Node)->getRight();
+  }
+}
+
+// Operator of a binary expression node; Expression and Term map onto the
+// BinaryOp operators
+inline BinaryOp::Operator getBinaryOperator(Expr *Node) {
+  if (auto *E = llvm::dyn_cast<Expression>(Node))
+    return E->getOperator() == Expression::Plus ? BinaryOp::Plus : BinaryOp::Minus;
+  if (auto *T = llvm::dyn_cast<Term>(Node))
+    return T->getOperator() == Term::mul
+               ? BinaryOp::Mul
+               : (T->getOperator() == Term::mod ? BinaryOp::mod : BinaryOp::Div);
+  return llvm::cast<BinaryOp>(Node)->getOperator();
+}
+
+// Folds the expression rooted at Root bottom-up, left operand first, with
+// an explicit stack instead of recursion, so nesting depth is bounded by
+// memory rather than by the call stack.
+//   Lookup(Expr *, T &)        may supply the value of a whole subtree,
+//                              which is then not walked
+//   Leaf(Final &)              value of a leaf
+//   Combine(Expr &, T L, T R)  value of a BinaryOp, Expression or Term
+template <typename T, typename LookupFn, typename LeafFn, typename CombineFn>
+T walkExpression(Expr *Root, LookupFn Lookup, LeafFn Leaf, CombineFn Combine) {
+  struct Frame {
+    Expr *Node;
+    bool OperandsDone;
+  };
+  llvm::SmallVector<Frame, 32> Work;
+  llvm::SmallVector<T, 32> Values;
+  Work.push_back({Root, false});
+  while (!Work.empty()) {
+    Frame F = Work.pop_back_val();
+    if (F.OperandsDone) {
+      T R = Values.pop_back_val();
+      T L = Values.pop_back_val();
+      Values.push_back(Combine(*F.Node, L, R));
+      continue;
+    }
+    T Known{};
+    if (Lookup(F.Node, Known)) {
+      Values.push_back(Known);
+      continue;
+    }
+    if (auto *Fin = llvm::dyn_cast<Final>(F.Node)) {
+      Values.push_back(Leaf(*Fin));
+      continue;
+    }
+    Work.push_back({F.Node, true});
+    Work.push_back({getRightOperand(F.Node), false});
+    Work.push_back({getLeftOperand(F.Node), false});
+  }
+  return Values.back();
+}
+
+// Whether Node is an expression walkExpression can fold
+inline bool isExpressionNode(AST *Node) {
+  return llvm::isa<Final>(Node) || llvm::isa<BinaryOp>(Node) || llvm::isa<Expression>(Node) ||
+         llvm::isa<Term>(Node);
+}
+
+#endif
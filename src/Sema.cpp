@@ -1,111 +1,531 @@
 #include "Sema.h"
-#include "llvm/ADT/StringSet.h"
+#include "DeclTable.h"
+#include "RecursiveVisitor.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using llvm::cast;
+using llvm::dyn_cast;
+using llvm::isa;
 
 namespace {
-class InputCheck : public ASTVisitor {
-  llvm::StringSet<> Scope; // StringSet to store declared variables
+class InputCheck : public RecursiveVisitor<InputCheck> {
+  DeclTable Decls; // Declarations in scope, resolved by interned symbol ID
   bool HasError; // Flag to indicate if an error occurred
+  const LineTable *Lines; // Resolves node offsets for diagnostics (may be null)
+  llvm::raw_ostream &OS; // Where diagnostics go
+  int32_t LocDelta = 0; // Shift of node offsets in the current statement, see StmtRange
+  IncrementalSema::StmtResult *Result = nullptr; // Records lookups and diagnostics instead of printing
 
   enum ErrorType { Twice, Not }; // Enum to represent error types: Twice - variable declared twice, Not - variable not declared
 
-  void error(ErrorType ET, llvm::StringRef V) {
-    // Function to report errors
-    llvm::errs() << "Variable " << V << " is "
-                 << (ET == Twice ? "already" : "not")
-                 << " declared\n";
+  void report(uint32_t Loc, const llvm::Twine &Msg) {
     HasError = true; // Set error flag to true
+    if (Result)
+      Result->Diags.push_back({Loc, Msg.str()});
+    else
+      printLoc(OS, Lines, Loc + LocDelta) << Msg << "\n";
+  }
+
+  void error(ErrorType ET, llvm::StringRef V, uint32_t Loc) {
+    // Function to report errors
+    report(Loc, "Variable " + V + " is " + (ET == Twice ? "already" : "not") + " declared");
+  }
+
+  uint32_t lookup(uint32_t Sym) {
+    uint32_t D = Decls.lookup(Sym);
+    if (Result)
+      Result->Reads.push_back({Sym, D});
+    return D;
   }
 
 public:
-  InputCheck() : HasError(false) {} // Constructor
+  using RecursiveVisitor<InputCheck>::visit; // Other nodes just visit their children
+
+  // Decls, if given, continues the declarations of the statements before
+  // the ones checked
+  InputCheck(const LineTable *Lines, llvm::raw_ostream &OS = llvm::errs(),
+             DeclTable Decls = DeclTable())
+      : Decls(std::move(Decls)), HasError(false), Lines(Lines), OS(OS) {}
 
   bool hasError() { return HasError; } // Function to check if an error occurred
 
+  DeclTable &getDecls() { return Decls; }
+
+  // Checks the top-level statement Stmt alone, into R
+  void checkStatement(Expr *Stmt, IncrementalSema::StmtResult &R) {
+    Result = &R;
+    dispatch(Stmt);
+    Result = nullptr;
+  }
+
+  // Attaches the declaration of an identifier to it, so CodeGen need not
+  // resolve the name again; false if it has none
+  bool resolve(Final &Node) {
+    uint32_t D = lookup(Node.getSym());
+    Node.setDecl(D);
+    return D != DeclTable::None;
+  }
+
   // Visit function for GSM nodes
-  virtual void visit(Goal &Node) override { 
-    for (auto I = Node.begin(), E = Node.end(); I != E; ++I)
+  void visit(Goal &Node) { checkStatements(Node, 0, Node.end() - Node.begin()); }
+
+  // Checks the top-level statements [Begin, End) of Node
+  void checkStatements(Goal &Node, size_t Begin, size_t End) {
+    for (size_t Idx = Begin; Idx != End; ++Idx)
     {
-      (*I)->accept(*this); // Visit each child node
+      LocDelta = Node.getLocDelta(Idx); // Statements reused by reparse() may be shifted
+      dispatch(Node.begin()[Idx]); // Visit each child node
     }
+    LocDelta = 0;
+  }
+
+  // Expressions are checked by an iterative walk, so any nesting depth is
+  // fine: identifiers must be declared and a divisor must not be a literal 0
+  void checkExpr(Expr *E) {
+    struct Unit {};
+    walkExpression<Unit>(
+        E, [](Expr *, Unit &) { return false; },
+        [&](Final &Node) {
+          if (Node.getKind() == Final::Id && !resolve(Node))
+            error(Not, Node.getVal(), Node.getLoc());
+          return Unit();
+        },
+        [&](Expr &Node, Unit, Unit) {
+          bool IsDiv = (isa<BinaryOp>(Node) && cast<BinaryOp>(Node).getOperator() == BinaryOp::Div) ||
+                       (isa<Term>(Node) && cast<Term>(Node).getOperator() == Term::slash);
+          auto *Divisor = dyn_cast<Final>(getRightOperand(&Node));
+          if (IsDiv && Divisor && Divisor->getKind() == Final::Number) {
+            int intval;
+            if (!Divisor->getVal().getAsInteger(10, intval) && intval == 0) {
+              report(Node.getLoc(), "Division by zero is not allowed.");
+            }
+          }
+          return Unit();
+        });
+  }
+
+  void visit(Final &Node) { checkExpr(&Node); }
+  void visit(BinaryOp &Node) { checkExpr(&Node); }
+  void visit(Expression &Node) { checkExpr(&Node); }
+  void visit(Term &Node) { checkExpr(&Node); }
+
+  // Visit function for Assignment nodes
+  void visit(Assignment &Node) {
+    Final *dest = Node.getLeft();
+
+    // Check if the identifier is in the scope
+    if (!resolve(*dest))
+      error(Not, dest->getVal(), dest->getLoc());
+
+    checkExpr(Node.getRight());
   };
 
-  // Visit function for Factor nodes
-  virtual void visit(Final &Node) override {
-    if (Node.getKind() == Final::Id) {
-      // Check if identifier is in the scope
-      if (Scope.find(Node.getVal()) == Scope.end())
-        error(Not, Node.getVal());
+  void visit(Define &Node) {
+    // Names get consecutive IDs from getFirstDecl(): the next ones, or
+    // those IncrementalSema chose
+    uint32_t ID = Result ? Result->FirstDecl : uint32_t(Decls.size());
+    Node.setFirstDecl(ID);
+    auto S = Node.sym_begin();
+    for (auto I = Node.begin(), E = Node.end(); I != E;
+         ++I, ++S) {
+      if (lookup(*S) != DeclTable::None)
+        error(Twice, *I, Node.getLoc()); // If the variable is already in Scope, report a "Twice" error
+      Decls.declare(*S, Node.getLoc(), ID++);
     }
+    for (auto I = Node.begin_values(), E = Node.end_values(); I != E; ++I)
+      checkExpr(*I); // Check each initializer expression
   };
 
-  // Visit function for BinaryOp nodes
-  virtual void visit(Assignment &Node) override {
-    if (Node.getLeft())
-      Node.getLeft()->accept(*this);
-    else
-      HasError = true;
+  // Each test before its body, in source order as the flat check goes
+  void visit(Condition &Node) {
+    auto B = Node.assignments_begin(), BE = Node.assignments_end();
+    for (auto C = Node.exprs_begin(), CE = Node.exprs_end(); C != CE; ++C) {
+      dispatch(*C);
+      if (B != BE)
+        dispatch(*B++);
+    }
+    for (; B != BE; ++B)
+      dispatch(*B);
+  }
+};
 
-    auto right = Node.getRight();
-    if (right)
-      right->accept(*this);
-    else
-      HasError = true;
+uint64_t hashWords(llvm::ArrayRef<uint64_t> Words) {
+  return llvm::xxHash64(llvm::StringRef(reinterpret_cast<const char *>(Words.data()),
+                                        Words.size() * sizeof(uint64_t)));
+}
 
-    if (Node.getOperator() == BinaryOp::Operator::Div && right) {
-      Factor * f = (Factor *)right;
+// Hashes what checking a top-level statement depends on: its shape,
+// operators, names, literals and node offsets from Base, the start the
+// statement's diagnostics are kept relative to
+class StmtHasher : public RecursiveVisitor<StmtHasher> {
+  llvm::SmallVector<uint64_t, 64> Words;
+  uint32_t Base;
 
-      if (right && f->getKind() == Factor::ValueKind::Number) {
-        int intval;
-        f->getVal().getAsInteger(10, intval);
+  void add(AST &Node, uint64_t Field) {
+    Words.push_back(Node.getNodeKind());
+    Words.push_back(Field);
+    Words.push_back(uint32_t(Node.getLoc() - Base));
+  }
 
-        if (intval == 0) {
-          llvm::errs() << "Division by zero is not allowed." << "\n";
-          HasError = true;
-        }
-      }
+public:
+  using RecursiveVisitor<StmtHasher>::visit;
+
+  explicit StmtHasher(uint32_t Base) : Base(Base) {}
+
+  uint64_t hash(Expr *Stmt) {
+    dispatch(Stmt);
+    return hashWords(Words);
+  }
+
+  // in post-order, which the node kinds make unambiguous
+  void addExpr(Expr *E) {
+    struct Unit {};
+    walkExpression<Unit>(
+        E, [](Expr *, Unit &) { return false; },
+        [&](Final &Node) {
+          add(Node, Node.getKind() == Final::Id ? Node.getSym() : llvm::xxHash64(Node.getVal()));
+          Words.push_back(Node.getKind());
+          return Unit();
+        },
+        [&](Expr &Node, Unit, Unit) {
+          add(Node, getBinaryOperator(&Node));
+          return Unit();
+        });
+  }
+
+  void visit(Final &Node) { addExpr(&Node); }
+  void visit(BinaryOp &Node) { addExpr(&Node); }
+  void visit(Expression &Node) { addExpr(&Node); }
+  void visit(Term &Node) { addExpr(&Node); }
+
+  void visit(Assignment &Node) {
+    add(Node, 0);
+    addExpr(Node.getLeft());
+    addExpr(Node.getRight());
+  }
+
+  void visit(Define &Node) {
+    add(Node, Node.sym_end() - Node.sym_begin());
+    Words.append(Node.sym_begin(), Node.sym_end());
+    Words.push_back(Node.end_values() - Node.begin_values());
+    RecursiveVisitor<StmtHasher>::visit(Node);
+  }
+
+  void visit(Condition &Node) {
+    add(Node, Node.exprs_end() - Node.exprs_begin());
+    Words.push_back(Node.assignments_end() - Node.assignments_begin());
+    RecursiveVisitor<StmtHasher>::visit(Node);
+  }
+
+  void visit(IF &Node) {
+    add(Node, Node.end() - Node.begin());
+    RecursiveVisitor<StmtHasher>::visit(Node);
+  }
+
+  void visit(Loop &Node) {
+    add(Node, 0);
+    RecursiveVisitor<StmtHasher>::visit(Node);
+  }
+};
+}
+
+size_t Sema::getNumRanges(size_t NumStmts, unsigned Threads) {
+  // more ranges than threads, so uneven statements still balance
+  const size_t RangesPerThread = 4;
+  const size_t MinRangeStmts = 1024;
+  if (Threads <= 1)
+    return 1;
+  return std::min<size_t>(size_t(Threads) * RangesPerThread, NumStmts / MinRangeStmts);
+}
+
+bool Sema::semantic(AST *Tree, const LineTable *Lines, unsigned Threads) {
+  if (!Tree)
+    return false; // If the input AST is not valid, return false indicating no errors
+
+  auto *Program = dyn_cast<Goal>(Tree);
+  size_t NumStmts = Program ? size_t(Program->end() - Program->begin()) : 0;
+  size_t Parts = getNumRanges(NumStmts, Threads);
+  if (Parts <= 1) {
+    InputCheck Check(Lines); // Create an instance of the InputCheck class for semantic analysis
+    Check.dispatch(Tree); // Initiate the semantic analysis by traversing the AST
+
+    return Check.hasError(); // Return the result of Check.hasError() indicating if any errors were detected during the analysis
+  }
+
+  // Declarations are only made by top-level Defines (blocks hold
+  // assignments), so one cheap pass over the statements numbers them the
+  // way the sequential check does and records the bindings in effect at
+  // the start of every range.
+  std::vector<size_t> Bounds;
+  std::vector<DeclTable> Tables;
+  std::vector<uint32_t> Bindings;
+  uint32_t NextDecl = 0;
+  for (size_t I = 0; I != NumStmts; ++I) {
+    if (I == Bounds.size() * NumStmts / Parts) {
+      Bounds.push_back(I);
+      Tables.emplace_back(Bindings, NextDecl);
+    }
+    auto *D = dyn_cast<Define>(Program->begin()[I]);
+    if (!D)
+      continue;
+    for (auto S = D->sym_begin(), E = D->sym_end(); S != E; ++S) {
+      assert(*S != SymbolTable::None && "not an interned identifier");
+      if (*S >= Bindings.size())
+        Bindings.resize(*S + 1, uint32_t(DeclTable::None));
+      Bindings[*S] = NextDecl++;
     }
+  }
+  Bounds.push_back(NumStmts);
+
+  // Then the ranges are checked independently, each writing diagnostics
+  // into a buffer of its own; they are printed in source order.
+  size_t NumRanges = Tables.size();
+  std::vector<std::string> Diags(NumRanges);
+  std::vector<char> Failed(NumRanges);
+  auto CheckRange = [&](size_t I) {
+    llvm::raw_string_ostream OS(Diags[I]);
+    InputCheck Check(Lines, OS, std::move(Tables[I]));
+    Check.checkStatements(*Program, Bounds[I], Bounds[I + 1]);
+    Failed[I] = Check.hasError();
   };
 
-  // Visit function for Assignment nodes
-  virtual void visit(Assignment &Node) override {
-    Factor *dest = Node.getLeft();
+  {
+    llvm::ThreadPool Pool(llvm::hardware_concurrency(Threads));
+    for (size_t I = 0; I < NumRanges; ++I)
+      Pool.async(CheckRange, I);
+    Pool.wait();
+  }
 
-    dest->accept(*this);
+  bool HasError = false;
+  for (size_t I = 0; I < NumRanges; ++I) {
+    llvm::errs() << Diags[I];
+    HasError |= Failed[I] != 0;
+  }
+  return HasError;
+}
 
-    if (dest->getKind() == Final::Number) {
-        llvm::errs() << "Assignment destination must be an identifier.";
-        HasError = true;
-    }
+bool IncrementalSema::semantic(Goal &Tree, const LineTable *Lines, llvm::raw_ostream &OS) {
+  llvm::ArrayRef<StmtRange> Ranges = Tree.getRanges();
+  size_t NumStmts = Tree.end() - Tree.begin();
+  size_t Old = Stmts.size();
+  // Node offsets of a statement are kept relative to this
+  auto base = [&](size_t I) {
+    return I < Ranges.size() ? uint32_t(Ranges[I].Begin - Ranges[I].LocDelta) : 0;
+  };
+  // reparse() reuses the statements outside the edit with their hashes
+  size_t Prefix = 0, Suffix = 0;
+  while (Prefix != std::min(Old, NumStmts) && Tree.getHash(Prefix) == Stmts[Prefix].Hash)
+    ++Prefix;
+  while (Suffix != std::min(Old, NumStmts) - Prefix &&
+         Tree.getHash(NumStmts - 1 - Suffix) == Stmts[Old - 1 - Suffix].Hash)
+    ++Suffix;
+  auto OldMiddle = llvm::ArrayRef<StmtResult>(Stmts).slice(Prefix, Old - Suffix - Prefix);
 
-    if (dest->getKind() == Final::Id) {
-      // Check if the identifier is in the scope
-      if (Scope.find(dest->getVal()) == Scope.end())
-        error(Not, dest->getVal());
-    }
+  InputCheck Check(Lines, OS);
+  DeclTable &Decls = Check.getDecls();
+  for (size_t I = 0; I != Prefix; ++I) {
+    uint32_t ID = Stmts[I].FirstDecl;
+    for (uint32_t Sym : Stmts[I].Declared)
+      Decls.bind(Sym, ID++);
+  }
 
-    if (Node.getRight())
-      Node.getRight()->accept(*this);
+  // The names the edit may declare differently, with their declaration
+  // after the old statements it replaced; and the IDs those declared, so
+  // new Defines can take them over
+  llvm::DenseMap<uint32_t, uint32_t> Last;
+  struct Run {
+    uint64_t Content;
+    uint32_t First, Count;
+    bool Taken;
   };
+  llvm::SmallVector<Run, 4> Retired;
+  for (const StmtResult &R : OldMiddle) {
+    for (uint32_t Sym : R.Declared)
+      Last.try_emplace(Sym, DeclTable::None);
+    if (!R.Declared.empty())
+      Retired.push_back({R.Content, R.FirstDecl, uint32_t(R.Declared.size()), false});
+  }
+  for (size_t I = Prefix; I != NumStmts - Suffix; ++I)
+    if (auto *D = dyn_cast<Define>(Tree.begin()[I]))
+      for (auto S = D->sym_begin(), SE = D->sym_end(); S != SE; ++S)
+        Last.try_emplace(*S, DeclTable::None);
+  for (auto &Entry : Last)
+    Entry.second = Decls.lookup(Entry.first);
+  for (const StmtResult &R : OldMiddle) {
+    uint32_t ID = R.FirstDecl;
+    for (uint32_t Sym : R.Declared)
+      Last[Sym] = ID++;
+  }
 
-  virtual void visit(Define &Node) override {
-    for (auto I = Node.begin(), E = Node.end(); I != E;
-         ++I) {
-      if (!Scope.insert(*I).second)
-        error(Twice, *I); // If the insertion fails (element already exists in Scope), report a "Twice" error
-    }
-    if (Node.getExprs())
-      Node.getExprs()->accept(*this); // If the Define node has an expression, recursively visit the expression node
+  auto check = [&](size_t I, StmtResult &R) {
+    R.Reads.clear();
+    R.Diags.clear();
+    Check.checkStatement(Tree.begin()[I], R);
+    llvm::SmallVector<uint64_t, 16> Words = {R.Content, R.FirstDecl};
+    for (const std::pair<uint32_t, uint32_t> &Read : R.Reads)
+      Words.push_back(uint64_t(Read.first) << 32 | Read.second);
+    R.Hash = std::max<uint64_t>(hashWords(Words), 1);
+    // A name is usually read more than once
+    llvm::sort(R.Reads);
+    R.Reads.erase(std::unique(R.Reads.begin(), R.Reads.end()), R.Reads.end());
+    R.ReadMask = 0;
+    for (const std::pair<uint32_t, uint32_t> &Read : R.Reads)
+      R.ReadMask |= uint64_t(1) << (Read.first % 64);
+    for (std::pair<uint32_t, std::string> &D : R.Diags)
+      D.first -= base(I);
+    Tree.setHash(I, R.Hash);
+    ++NumChecked;
   };
-};
+
+  NumChecked = 0;
+  std::vector<StmtResult> Middle(NumStmts - Suffix - Prefix);
+  for (size_t I = Prefix; I != NumStmts - Suffix; ++I) {
+    StmtResult &R = Middle[I - Prefix];
+    Expr *Stmt = Tree.begin()[I];
+    R.Content = StmtHasher(base(I)).hash(Stmt);
+    if (auto *D = dyn_cast<Define>(Stmt)) {
+      R.Declared.assign(D->sym_begin(), D->sym_end());
+      // The IDs of the same Define before the edit, or of one as long, so
+      // the statements after it need not change; else free ones
+      uint32_t Count = uint32_t(R.Declared.size());
+      auto Same = llvm::find_if(Retired, [&](const Run &Old) {
+        return !Old.Taken && Old.Content == R.Content && Old.Count == Count;
+      });
+      if (Same == Retired.end())
+        Same = llvm::find_if(Retired, [&](const Run &Old) { return !Old.Taken && Old.Count == Count; });
+      auto Free = FreeDecls.find(Count);
+      if (Same != Retired.end()) {
+        Same->Taken = true;
+        R.FirstDecl = Same->First;
+      } else if (Free != FreeDecls.end() && !Free->second.empty()) {
+        R.FirstDecl = Free->second.pop_back_val();
+      } else {
+        R.FirstDecl = NextDecl;
+        NextDecl += Count;
+      }
+    }
+    check(I, R);
+  }
+  for (const Run &R : Retired)
+    if (!R.Taken)
+      FreeDecls[R.Count].push_back(R.First);
+
+  // Only statements after the edit that read a name now declared
+  // differently are checked again
+  uint64_t ChangedMask = 0;
+  for (auto &Entry : Last)
+    if (Decls.lookup(Entry.first) != Entry.second)
+      ChangedMask |= uint64_t(1) << (Entry.first % 64);
+  for (size_t I = NumStmts - Suffix, J = Old - Suffix; ChangedMask && I != NumStmts; ++I, ++J) {
+    StmtResult &R = Stmts[J];
+    if ((R.ReadMask & ChangedMask) &&
+        !llvm::all_of(R.Reads, [&](const std::pair<uint32_t, uint32_t> &Read) {
+          return Decls.lookup(Read.first) == Read.second;
+        })) {
+      check(I, R);
+    } else {
+      uint32_t ID = R.FirstDecl;
+      for (uint32_t Sym : R.Declared)
+        Decls.bind(Sym, ID++);
+    }
+  }
+
+  if (Middle.size() == OldMiddle.size()) {
+    std::move(Middle.begin(), Middle.end(), Stmts.begin() + Prefix);
+  } else {
+    Stmts.erase(Stmts.begin() + Prefix, Stmts.begin() + (Old - Suffix));
+    Stmts.insert(Stmts.begin() + Prefix, std::make_move_iterator(Middle.begin()),
+                 std::make_move_iterator(Middle.end()));
+  }
+
+  // Locations are those of this version
+  bool HasError = false;
+  for (size_t I = 0; I != NumStmts; ++I) {
+    uint32_t Begin = I < Ranges.size() ? Ranges[I].Begin : 0;
+    for (const std::pair<uint32_t, std::string> &D : Stmts[I].Diags)
+      printLoc(OS, Lines, D.first + Begin) << D.second << "\n";
+    HasError |= !Stmts[I].Diags.empty();
+  }
+  return HasError;
 }
 
-bool Sema::semantic(AST *Tree) {
-  if (!Tree)
-    return false; // If the input AST is not valid, return false indicating no errors
+// Checks a FlatAST in one forward scan; see Early for how statements
+// resolve their names before the expressions they hold, which precede them.
+bool Sema::semantic(const FlatAST &Flat, const SymbolTable &Symbols,
+                    const LineTable *Lines) {
+  std::vector<bool> Scope;
+  bool HasError = false;
+  auto isDeclared = [&](uint32_t Sym) { return Sym < Scope.size() && Scope[Sym]; };
+  auto notDeclared = [&](uint32_t Sym, uint32_t Loc) {
+    printLoc(llvm::errs(), Lines, Loc) << "Variable " << Symbols.getName(Sym)
+                                       << " is not declared\n";
+    HasError = true;
+  };
+  auto declare = [&](size_t N) {
+    for (uint32_t I = Flat.A[N], End = Flat.A[N] + Flat.B[N]; I != End; ++I) {
+      uint32_t Sym = Flat.Extra[I];
+      if (Sym >= Scope.size())
+        Scope.resize(Sym + 1);
+      if (Scope[Sym]) {
+        printLoc(llvm::errs(), Lines, Flat.Locs[N]) << "Variable " << Symbols.getName(Sym)
+                                                    << " is already declared\n";
+        HasError = true;
+      }
+      Scope[Sym] = true;
+    }
+  };
 
-  InputCheck Check; // Create an instance of the InputCheck class for semantic analysis
-  Tree->accept(Check); // Initiate the semantic analysis by traversing the AST using the accept function
+  // The tree check declares a Define's names before its initializers and
+  // resolves an assignment's target before its value, but both statement
+  // nodes follow those expressions; so that is done on reaching the first
+  // node of the first initializer, or of the value (FlatAST::firstNode).
+  std::vector<std::pair<size_t, size_t>> Early; // (first node, statement)
+  for (size_t N = 0, E = Flat.size(); N != E; ++N) {
+    if (Flat.Kinds[N] == FlatAST::Assign)
+      Early.emplace_back(Flat.firstNode(Flat.B[N]), N);
+    else if (Flat.Kinds[N] == FlatAST::Define && Flat.B[N] &&
+             Flat.Extra[Flat.A[N] + Flat.B[N]] != FlatAST::None)
+      Early.emplace_back(Flat.firstNode(Flat.Extra[Flat.A[N] + Flat.B[N]]), N);
+  }
+  auto NextEarly = Early.begin();
 
-  return Check.hasError(); // Return the result of Check.hasError() indicating if any errors were detected during the analysis
+  for (size_t N = 0, E = Flat.size(); N != E; ++N) {
+    if (NextEarly != Early.end() && NextEarly->first == N) {
+      size_t Stmt = (NextEarly++)->second;
+      if (Flat.Kinds[Stmt] == FlatAST::Define)
+        declare(Stmt);
+      else if (!isDeclared(Flat.A[Stmt]))
+        notDeclared(Flat.A[Stmt], Flat.Locs[Stmt]);
+    }
+    switch (Flat.Kinds[N]) {
+    case FlatAST::Ident:
+      if (!isDeclared(Flat.A[N]))
+        notDeclared(Flat.A[N], Flat.Locs[N]);
+      break;
+    case FlatAST::Binary: {
+      uint32_t R = Flat.B[N];
+      if (Flat.Ops[N] == BinaryOp::Div && Flat.Kinds[R] == FlatAST::Number &&
+          Flat.A[R] == 0) {
+        printLoc(llvm::errs(), Lines, Flat.Locs[N]) << "Division by zero is not allowed." << "\n";
+        HasError = true;
+      }
+      break;
+    }
+    case FlatAST::Define:
+      // without initializers, nothing was declared early
+      if (NextEarly == Early.begin() || std::prev(NextEarly)->second != N)
+        declare(N);
+      break;
+    default:
+      break;
+    }
+  }
+  return HasError;
 }
@@ -2,11 +2,84 @@
 #define SEMA_H
 
 #include "AST.h"
+#include "FlatAST.h"
 #include "Lexer.h"
+#include "LineTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
 
 class Sema {
 public:
-  bool semantic(AST *Tree);
+  // Lines, if given, turns node offsets into line:col in diagnostics.
+  // With Threads > 1, a large program's top-level statements are checked
+  // in ranges on a thread pool, with the same results and diagnostics.
+  // Ranges resolve their names concurrently, so Tree must not share
+  // nodes between statements (see ASTContext::setShareExprs).
+  bool semantic(AST *Tree, const LineTable *Lines = nullptr,
+                unsigned Threads = 1);
+  // Ranges semantic() splits NumStmts top-level statements into for
+  // Threads; at most one means they are checked on the calling thread
+  static size_t getNumRanges(size_t NumStmts, unsigned Threads);
+  // Same checks as a single forward scan over a flattened tree
+  bool semantic(const FlatAST &Flat, const SymbolTable &Symbols,
+                const LineTable *Lines = nullptr);
+};
+
+// IncrementalSema checks successive versions of a program, as built by
+// reparse(), and rechecks only the top-level statements that are new or
+// read a name whose declaration changed. A statement's result is known by
+// a hash of its content and resolutions (see StmtRange::Hash), which
+// reparse() keeps with a statement it reuses; the statements before and
+// after an edit match the last version by hash and are not walked again. They still hold
+// their resolutions, and one after the edit is only looked at if it read
+// a name the edited statements declare differently now. Declaration IDs
+// stay stable across checks, and the IDs of declarations that left the
+// program are handed out again. Statements must not be changed in place
+// between checks: ConstantFold rewrites them, so a version is folded only
+// after its last check, and neither it nor a later version built from it
+// by reparse() is checked again.
+class IncrementalSema {
+public:
+  // What checking one top-level statement found
+  struct StmtResult {
+    uint64_t Content = 0; // hash of its content
+    // Hash of its content and what it resolved to, never 0; it is kept in
+    // StmtRange::Hash, as the statement's nodes hold those resolutions
+    uint64_t Hash = 0;
+    // Each symbol looked up and its declaration then (None if undeclared)
+    llvm::SmallVector<std::pair<uint32_t, uint32_t>, 4> Reads;
+    uint64_t ReadMask = 0; // bit Sym % 64 of every symbol in Reads
+    // Offset from the start of the statement, and message
+    llvm::SmallVector<std::pair<uint32_t, std::string>, 0> Diags;
+    // Names a Define declares, with consecutive IDs from FirstDecl
+    llvm::SmallVector<uint32_t, 2> Declared;
+    uint32_t FirstDecl = 0;
+  };
+
+private:
+  std::vector<StmtResult> Stmts; // of the last checked version, in order
+  // Runs of free declaration IDs: first ID of each, by length
+  llvm::DenseMap<uint32_t, llvm::SmallVector<uint32_t, 4>> FreeDecls;
+  uint32_t NextDecl = 0; // IDs from here on were never used
+  unsigned NumChecked = 0;
+
+public:
+  // Same result and diagnostics as Sema::semantic on Tree; they are
+  // printed to OS
+  bool semantic(Goal &Tree, const LineTable *Lines = nullptr,
+                llvm::raw_ostream &OS = llvm::errs());
+
+  // Statements the last semantic() call had to check again
+  unsigned getNumChecked() const { return NumChecked; }
+
+  // Declaration IDs handed out so far, taken or free
+  uint32_t getNumDeclIDs() const { return NextDecl; }
 };
 
 #endif
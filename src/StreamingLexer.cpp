@@ -0,0 +1,61 @@
+#include "StreamingLexer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+void StreamingLexer::next(Token &token)
+{
+    while (true)
+    {
+        Lex.next(token);
+        // eoi, or a token reaching the end of the window, may continue in
+        // the next chunk (e.g. "beg" | "in" or "+" | "=")
+        bool AtWindowEnd = token.is(Token::eoi) ||
+                           token.getText().end() == Buffer.data() + Valid;
+        if (!AtWindowEnd || AtEOF)
+            break;
+        fill(token.is(Token::eoi) ? Valid : token.getText().data() - Buffer.data());
+    }
+
+    uint64_t Offset = WindowOffset + token.Offset;
+    token.Offset = uint32_t(std::min<uint64_t>(Offset, UINT32_MAX));
+    // interned only now: the window lexer may have seen part of the name
+    if (Symbols && token.is(Token::id))
+    {
+        token.Sym = Symbols->intern(token.Text);
+        token.Text = Symbols->getName(token.Sym);
+    }
+    else if (Saver && token.isOneOf(Token::id, Token::number))
+        token.Text = Saver->save(token.Text);
+}
+
+// drops everything before Pos, appends one chunk and restarts the lexer at
+// the front of the window
+void StreamingLexer::fill(size_t Pos)
+{
+    size_t Keep = Valid - Pos;
+    memmove(Buffer.data(), Buffer.data() + Pos, Keep);
+    WindowOffset += Pos;
+    Valid = Keep;
+
+    // only grows beyond one chunk for a token longer than ChunkSize
+    if (Buffer.size() < Valid + ChunkSize + 1)
+        Buffer.resize(Valid + ChunkSize + 1);
+
+    llvm::Expected<size_t> ReadOrErr = llvm::sys::fs::readNativeFile(
+        File, llvm::MutableArrayRef<char>(Buffer.data() + Valid, ChunkSize));
+    if (!ReadOrErr)
+    {
+        llvm::errs() << "Error reading input: " << llvm::toString(ReadOrErr.takeError()) << "\n";
+        ReadError = true;
+        AtEOF = true;
+    }
+    else if (*ReadOrErr == 0)
+        AtEOF = true;
+    else
+        Valid += *ReadOrErr;
+
+    Buffer[Valid] = '\0';
+    Lex = Lexer(llvm::StringRef(Buffer.data(), Valid));
+}
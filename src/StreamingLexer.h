@@ -0,0 +1,51 @@
+#ifndef STREAMINGLEXER_H
+#define STREAMINGLEXER_H
+
+#include "Lexer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/StringSaver.h"
+#include <vector>
+
+// StreamingLexer lexes a file or pipe in fixed-size chunks instead of
+// requiring the whole input in memory. It keeps a window holding the
+// unconsumed tail plus one chunk, so memory stays bounded by the chunk
+// size plus the longest token. A token that runs into the end of the
+// window is re-lexed once the next chunk has been appended.
+//
+// The text of a returned token is only valid until the next call, unless
+// a StringSaver is given: identifier and number texts are then copied
+// into it so they can be stored in the AST. With a SymbolTable,
+// identifiers are interned and their text points at the interned name.
+//
+// Inputs of any size are read; token offsets are those in the whole
+// input, but stop at UINT32_MAX beyond 4 GiB, since the AST keeps 32-bit
+// locations.
+class StreamingLexer
+{
+    llvm::sys::fs::file_t File;
+    size_t ChunkSize;
+    llvm::StringSaver *Saver;
+    SymbolTable *Symbols;
+    std::vector<char> Buffer; // Buffer[Valid] is always NUL
+    size_t Valid;             // number of input bytes in Buffer
+    uint64_t WindowOffset;    // input offset of Buffer[0]
+    bool AtEOF;
+    bool ReadError;
+    Lexer Lex; // lexes the current window
+
+public:
+    StreamingLexer(llvm::sys::fs::file_t File, size_t ChunkSize = 64 * 1024,
+                   llvm::StringSaver *Saver = nullptr, SymbolTable *Symbols = nullptr)
+        : File(File), ChunkSize(ChunkSize), Saver(Saver), Symbols(Symbols), Buffer(1, '\0'),
+          Valid(0), WindowOffset(0), AtEOF(false), ReadError(false), Lex(llvm::StringRef(Buffer.data(), 0)) {}
+
+    void next(Token &token); // return the next token
+
+    // true if reading the input failed; the token stream then ends early
+    bool hasReadError() const { return ReadError; }
+
+private:
+    void fill(size_t Pos);
+};
+
+#endif
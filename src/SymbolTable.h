@@ -0,0 +1,34 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <vector>
+
+// SymbolTable interns identifiers into dense 32-bit IDs in order of first
+// appearance. The lexer interns each identifier once, and later phases
+// index flat vectors by ID instead of hashing the name again. The table
+// owns copies of the names, so they outlive the input buffer.
+class SymbolTable
+{
+    llvm::StringMap<uint32_t> IDs;
+    std::vector<llvm::StringRef> Names; // keys owned by IDs
+
+public:
+    static const uint32_t None = ~0u; // tokens and nodes that are not identifiers
+
+    uint32_t intern(llvm::StringRef Name)
+    {
+        auto Res = IDs.try_emplace(Name, uint32_t(Names.size()));
+        if (Res.second)
+            Names.push_back(Res.first->getKey());
+        return Res.first->second;
+    }
+
+    llvm::StringRef getName(uint32_t ID) const { return Names[ID]; }
+
+    size_t size() const { return Names.size(); }
+};
+
+#endif
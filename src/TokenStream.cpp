@@ -0,0 +1,129 @@
+#include "TokenStream.h"
+#include "llvm/Support/ThreadPool.h"
+#include <algorithm>
+#include <vector>
+
+TokenStream::TokenStream(Lexer &Lex) : BufferStart(Lex.getBufferStart())
+{
+    lexAll(Lex);
+}
+
+void TokenStream::lexAll(Lexer &Lex)
+{
+    Token Tok;
+    do
+    {
+        Lex.next(Tok);
+        Kinds.push_back(Tok.getKind());
+        Offsets.push_back(Tok.getOffset());
+        Syms.push_back(Tok.getSym());
+        // eoi carries no text of its own
+        if (Tok.is(Token::eoi))
+        {
+            Lengths.push_back(0);
+            break;
+        }
+        Lengths.push_back(uint32_t(Tok.getText().size()));
+    } while (true);
+}
+
+namespace
+{
+    // more chunks than threads, so uneven chunks still balance
+    const unsigned ChunksPerThread = 4;
+
+    // a chunk too small to be worth a task of its own
+    const size_t MinChunkSize = 64 * 1024;
+}
+
+TokenStream::TokenStream(llvm::StringRef Buffer, unsigned Threads, SymbolTable *Symbols)
+    : BufferStart(Buffer.data())
+{
+    if (Threads <= 1)
+    {
+        Lexer Lex(Buffer, Symbols);
+        lexAll(Lex);
+        return;
+    }
+
+    // the language has no comments or string literals, so every ';'
+    // ends a token and the next chunk can start right after it
+    std::vector<size_t> Bounds(1, 0);
+    size_t Target = Buffer.size() / (Threads * ChunksPerThread);
+    Target = std::max(Target, MinChunkSize);
+    while (Bounds.back() + Target < Buffer.size())
+    {
+        size_t Semi = Buffer.find(';', Bounds.back() + Target);
+        if (Semi == llvm::StringRef::npos)
+            break;
+        Bounds.push_back(Semi + 1);
+    }
+    Bounds.push_back(Buffer.size());
+
+    // a token belongs to the chunk it starts in; each chunk stops before eoi.
+    // Chunks intern into tables of their own, merged below without locking.
+    size_t NumChunks = Bounds.size() - 1;
+    std::vector<TokenStream> Chunks(NumChunks, TokenStream(Buffer.data()));
+    std::vector<SymbolTable> LocalSymbols(Symbols ? NumChunks : 0);
+    auto LexChunk = [&](size_t I)
+    {
+        Lexer Lex(Buffer, Bounds[I], Symbols ? &LocalSymbols[I] : nullptr);
+        TokenStream &C = Chunks[I];
+        Token Tok;
+        while (true)
+        {
+            Lex.next(Tok);
+            if (Tok.is(Token::eoi) || Tok.getOffset() >= Bounds[I + 1])
+                break;
+            C.Kinds.push_back(Tok.getKind());
+            C.Offsets.push_back(Tok.getOffset());
+            C.Lengths.push_back(uint32_t(Tok.getText().size()));
+            C.Syms.push_back(Tok.getSym());
+        }
+    };
+
+    {
+        llvm::ThreadPool Pool(llvm::hardware_concurrency(Threads));
+        for (size_t I = 0; I < NumChunks; ++I)
+            Pool.async(LexChunk, I);
+        Pool.wait();
+    }
+
+    size_t Total = 1;
+    for (const TokenStream &C : Chunks)
+        Total += C.size();
+    Kinds.reserve(Total);
+    Offsets.reserve(Total);
+    Lengths.reserve(Total);
+    Syms.reserve(Total);
+    std::vector<uint32_t> Remap;
+    for (size_t I = 0; I < NumChunks; ++I)
+    {
+        // only each chunk's distinct names are hashed again; local IDs are
+        // in first-appearance order, so global IDs match a sequential lex
+        Remap.clear();
+        if (Symbols)
+            for (size_t L = 0, E = LocalSymbols[I].size(); L < E; ++L)
+                Remap.push_back(Symbols->intern(LocalSymbols[I].getName(uint32_t(L))));
+        append(Chunks[I], Remap);
+    }
+
+    Kinds.push_back(Token::eoi);
+    Offsets.push_back(uint32_t(Buffer.size()));
+    Lengths.push_back(0);
+    Syms.push_back(SymbolTable::None);
+}
+
+void TokenStream::append(const TokenStream &Other, llvm::ArrayRef<uint32_t> Remap)
+{
+    Kinds.append(Other.Kinds.begin(), Other.Kinds.end());
+    Offsets.append(Other.Offsets.begin(), Other.Offsets.end());
+    Lengths.append(Other.Lengths.begin(), Other.Lengths.end());
+    if (Remap.empty())
+    {
+        Syms.append(Other.Syms.begin(), Other.Syms.end());
+        return;
+    }
+    for (uint32_t Sym : Other.Syms)
+        Syms.push_back(Sym == SymbolTable::None ? Sym : Remap[Sym]);
+}
@@ -0,0 +1,63 @@
+#ifndef TOKENSTREAM_H
+#define TOKENSTREAM_H
+
+#include "Lexer.h"
+#include "llvm/ADT/SmallVector.h"
+#include <cstdint>
+
+// TokenStream holds the whole input lexed up front as parallel arrays
+// (kind, 32-bit offset, 32-bit length, symbol ID) so the parser can look ahead any
+// number of tokens; inputs are limited to 4 GiB. The last token is
+// always eoi.
+class TokenStream
+{
+    const char *BufferStart;
+    llvm::SmallVector<Token::TokenKind, 0> Kinds;
+    llvm::SmallVector<uint32_t, 0> Offsets;
+    llvm::SmallVector<uint32_t, 0> Lengths;
+    llvm::SmallVector<uint32_t, 0> Syms;
+
+public:
+    // drains Lex up to and including eoi
+    explicit TokenStream(Lexer &Lex);
+
+    // lexes Buffer (NUL terminated) on Threads worker threads. The input is
+    // split right after ';' characters, lexed chunk by chunk and the
+    // per-chunk arrays are concatenated in source order. Identifiers are
+    // interned into Symbols, if given, in the same order a single Lexer
+    // would intern them.
+    TokenStream(llvm::StringRef Buffer, unsigned Threads, SymbolTable *Symbols = nullptr);
+
+    size_t size() const { return Kinds.size(); }
+
+    // indices past the end yield the final eoi token
+    Token::TokenKind getKind(size_t I) const { return Kinds[clamp(I)]; }
+
+    llvm::StringRef getText(size_t I) const
+    {
+        I = clamp(I);
+        return llvm::StringRef(BufferStart + Offsets[I], Lengths[I]);
+    }
+
+    void getToken(size_t I, Token &Tok) const
+    {
+        I = clamp(I);
+        Tok.Kind = Kinds[I];
+        Tok.Offset = Offsets[I];
+        Tok.Sym = Syms[I];
+        Tok.Text = llvm::StringRef(BufferStart + Offsets[I], Lengths[I]);
+    }
+
+private:
+    // an empty stream over BufferStart, used for per-chunk results
+    explicit TokenStream(const char *BufferStart) : BufferStart(BufferStart) {}
+
+    void lexAll(Lexer &Lex);
+
+    // appends Other, translating its symbol IDs through Remap if not empty
+    void append(const TokenStream &Other, llvm::ArrayRef<uint32_t> Remap);
+
+    size_t clamp(size_t I) const { return I < Kinds.size() ? I : Kinds.size() - 1; }
+};
+
+#endif